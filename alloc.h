@@ -0,0 +1,416 @@
+/**
+ * Copyright (c) 2014-2017 Robert Maupin <chasesan@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SONGBIRD_ALLOC_H__
+#define __SONGBIRD_ALLOC_H__
+
+#ifndef __SB_NO_ALLOC__
+#include <stdlib.h>
+#define sb_malloc malloc
+#define sb_realloc realloc
+#define sb_free free
+#endif /* __SB_NO_ALLOC__ */
+
+#ifndef __SB_ALLOCATOR__
+#define __SB_ALLOCATOR__
+#include <stddef.h>
+/*
+ * A runtime allocator, handed to a container when it is initialized. A NULL
+ * allocator stands for sb_malloc, sb_realloc and sb_free. The allocator has
+ * to outlive every container using it and release has to accept NULL.
+ * alloc.h provides arena and pool allocators.
+ */
+typedef struct sb_allocator {
+	void *(*alloc)(void *context, size_t size);
+	void *(*resize)(void *context, void *ptr, size_t size);
+	void (*release)(void *context, void *ptr);
+	void *context;
+} sb_allocator_t;
+#define __sb_allocate(a, size) \
+	((a) ? (a)->alloc((a)->context, (size)) : sb_malloc(size))
+#define __sb_reallocate(a, ptr, size) \
+	((a) ? (a)->resize((a)->context, (ptr), (size)) : sb_realloc((ptr), (size)))
+#define __sb_deallocate(a, ptr) \
+	((a) ? (a)->release((a)->context, (ptr)) : sb_free(ptr))
+#endif
+
+#include <string.h>
+
+#ifdef __cplusplus
+/* Not sure why you would want to use this in C++, but just in case. */
+extern "C" {
+#define __songbird_header__	inline
+/* Works even if __STDC_VERSION__ is not defined. */
+#elif __STDC_VERSION__ <= 199409L
+#define __songbird_header__	static __inline__
+#else
+#define __songbird_header__	static inline
+#endif
+
+/*
+ * Allocators for the sb_allocator_t interface. Neither of them locks, give
+ * each thread its own so that workers never contend on malloc.
+ */
+
+enum {
+	/* every block handed out is aligned to this */
+	SB_ALLOC_ALIGN = 16,
+	SB_ARENA_DEFAULT_CHUNK = 64 * 1024
+};
+
+/**
+ * @brief A bump allocator.
+ * Allocation moves a pointer forward through a chunk of memory, freeing a
+ * single block does nothing. Everything is given back at once with
+ * sb_arena_reset, which suits memory that lives exactly as long as one
+ * request. Pass &arena->allocator to a container to have it allocate here.
+ * It is highly recommended you do not change any values in this structure
+ * manually.
+ */
+typedef struct sb_arena {
+	sb_allocator_t allocator;
+	struct __sb_arena_chunk *chunk;
+	size_t chunk_size;
+	void *last;
+} sb_arena_t;
+
+/**
+ * @brief A fixed size block allocator.
+ * Blocks are carved out of larger slabs and returned to a free list, so
+ * allocating and freeing are a couple of pointer moves. Requests larger than
+ * the block size fail. Pass &pool->allocator to a container to have it
+ * allocate here. It is highly recommended you do not change any values in
+ * this structure manually.
+ */
+typedef struct sb_pool {
+	sb_allocator_t allocator;
+	void *free_list;
+	void *slabs;
+	size_t block_size;
+	unsigned blocks_per_slab;
+} sb_pool_t;
+
+/**
+ * Initializes the specified arena. No memory is allocated until the first
+ * allocation.
+ * @param arena The arena to initialize.
+ * @param chunk_size The size of the chunks taken from sb_malloc, if 0 it
+ * 		defaults to 64 KiB (the SB_ARENA_DEFAULT_CHUNK). Larger blocks get a
+ * 		chunk of their own.
+ */
+__songbird_header__
+void sb_arena_init(sb_arena_t *arena, size_t chunk_size);
+
+/**
+ * Allocates a block from the arena.
+ * @param arena The arena.
+ * @param size The size of the block.
+ * @return The block, or NULL if the memory allocation fails.
+ */
+__songbird_header__
+void *sb_arena_alloc(sb_arena_t *arena, size_t size);
+
+/**
+ * Resizes a block from the arena. The most recent block grows in place when
+ * the chunk has room, which makes a growing container cheap, any other block
+ * is copied to a new one.
+ * @param arena The arena.
+ * @param ptr The block, or NULL to allocate a new one.
+ * @param size The new size of the block.
+ * @return The block, or NULL if the memory allocation fails, in which case
+ * 		the old block is left as it is.
+ */
+__songbird_header__
+void *sb_arena_resize(sb_arena_t *arena, void *ptr, size_t size);
+
+/**
+ * Gives every block back to the arena at once. One chunk is kept for reuse,
+ * all others are freed. Containers using the arena must not be used
+ * afterwards.
+ * @param arena The arena.
+ */
+__songbird_header__
+void sb_arena_reset(sb_arena_t *arena);
+
+/**
+ * Frees all memory held by the arena.
+ * @param arena The arena.
+ */
+__songbird_header__
+void sb_arena_free(sb_arena_t *arena);
+
+/**
+ * Initializes the specified pool. No memory is allocated until the first
+ * allocation.
+ * @param pool The pool to initialize.
+ * @param block_size The size of every block.
+ * @param blocks_per_slab How many blocks each sb_malloc call provides, if 0
+ * 		it defaults to 64.
+ */
+__songbird_header__
+void sb_pool_init(sb_pool_t *pool, size_t block_size, unsigned blocks_per_slab);
+
+/**
+ * Takes a block from the pool.
+ * @param pool The pool.
+ * @return The block, or NULL if the memory allocation fails.
+ */
+__songbird_header__
+void *sb_pool_alloc(sb_pool_t *pool);
+
+/**
+ * Returns a block to the pool. Does nothing if the block is NULL.
+ * @param pool The pool.
+ * @param ptr The block.
+ */
+__songbird_header__
+void sb_pool_release(sb_pool_t *pool, void *ptr);
+
+/**
+ * Frees all memory held by the pool, including blocks still in use.
+ * @param pool The pool.
+ */
+__songbird_header__
+void sb_pool_free(sb_pool_t *pool);
+
+/* function definitions */
+
+struct __sb_arena_chunk {
+	struct __sb_arena_chunk *next;
+	size_t size;
+	size_t used;
+};
+
+/* the size of every block is kept in front of it, for sb_arena_resize */
+#define __SB_ALLOC_ROUND(n) (((n) + SB_ALLOC_ALIGN - 1) & ~(size_t)(SB_ALLOC_ALIGN - 1))
+#define __SB_ARENA_HEADER __SB_ALLOC_ROUND(sizeof(struct __sb_arena_chunk))
+#define __SB_ARENA_PREFIX __SB_ALLOC_ROUND(sizeof(size_t))
+
+__songbird_header__
+void *__sb_arena_alloc_callback(void *context, size_t size) {
+	return sb_arena_alloc((sb_arena_t *)context, size);
+}
+
+__songbird_header__
+void *__sb_arena_resize_callback(void *context, void *ptr, size_t size) {
+	return sb_arena_resize((sb_arena_t *)context, ptr, size);
+}
+
+__songbird_header__
+void __sb_arena_release_callback(void *context, void *ptr) {
+	/* blocks are only given back all at once */
+	(void)context;
+	(void)ptr;
+}
+
+__songbird_header__
+void sb_arena_init(sb_arena_t *arena, size_t chunk_size) {
+	arena->allocator.alloc = __sb_arena_alloc_callback;
+	arena->allocator.resize = __sb_arena_resize_callback;
+	arena->allocator.release = __sb_arena_release_callback;
+	arena->allocator.context = arena;
+	arena->chunk = NULL;
+	arena->chunk_size = chunk_size ? chunk_size : (size_t)SB_ARENA_DEFAULT_CHUNK;
+	arena->last = NULL;
+}
+
+__songbird_header__
+void *sb_arena_alloc(sb_arena_t *arena, size_t size) {
+	struct __sb_arena_chunk *chunk = arena->chunk;
+	size_t needed;
+	unsigned char *block;
+	if(size > (size_t)-1 - __SB_ARENA_HEADER - __SB_ARENA_PREFIX - SB_ALLOC_ALIGN) {
+		return NULL;
+	}
+	needed = __SB_ARENA_PREFIX + __SB_ALLOC_ROUND(size);
+	if(chunk == NULL || chunk->size - chunk->used < needed) {
+		size_t chunk_size = arena->chunk_size;
+		if(chunk_size < needed) {
+			chunk_size = needed;
+		}
+		chunk = (struct __sb_arena_chunk *)sb_malloc(__SB_ARENA_HEADER + chunk_size);
+		if(chunk == NULL) {
+			return NULL;
+		}
+		chunk->next = arena->chunk;
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		arena->chunk = chunk;
+	}
+	block = (unsigned char *)chunk + __SB_ARENA_HEADER + chunk->used;
+	chunk->used += needed;
+	*(size_t *)block = size;
+	arena->last = block + __SB_ARENA_PREFIX;
+	return arena->last;
+}
+
+__songbird_header__
+void *sb_arena_resize(sb_arena_t *arena, void *ptr, size_t size) {
+	struct __sb_arena_chunk *chunk = arena->chunk;
+	size_t old_size;
+	size_t start;
+	void *block;
+	if(ptr == NULL) {
+		return sb_arena_alloc(arena, size);
+	}
+	old_size = *(size_t *)((unsigned char *)ptr - __SB_ARENA_PREFIX);
+	if(ptr == arena->last && size <= (size_t)-1 - SB_ALLOC_ALIGN) {
+		/* the newest block can grow into the rest of its chunk */
+		start = (size_t)((unsigned char *)ptr - ((unsigned char *)chunk + __SB_ARENA_HEADER));
+		if(__SB_ALLOC_ROUND(size) <= chunk->size - start) {
+			chunk->used = start + __SB_ALLOC_ROUND(size);
+			*(size_t *)((unsigned char *)ptr - __SB_ARENA_PREFIX) = size;
+			return ptr;
+		}
+	}
+	if(size <= old_size) {
+		return ptr;
+	}
+	block = sb_arena_alloc(arena, size);
+	if(block == NULL) {
+		return NULL;
+	}
+	memcpy(block, ptr, old_size);
+	return block;
+}
+
+__songbird_header__
+void sb_arena_reset(sb_arena_t *arena) {
+	struct __sb_arena_chunk *chunk = arena->chunk;
+	struct __sb_arena_chunk *next;
+	if(chunk == NULL) {
+		return;
+	}
+	/* keep the newest chunk, it is usually the largest */
+	next = chunk->next;
+	while(next != NULL) {
+		struct __sb_arena_chunk *after = next->next;
+		sb_free(next);
+		next = after;
+	}
+	chunk->next = NULL;
+	chunk->used = 0;
+	arena->last = NULL;
+}
+
+__songbird_header__
+void sb_arena_free(sb_arena_t *arena) {
+	sb_arena_reset(arena);
+	sb_free(arena->chunk);
+	arena->chunk = NULL;
+}
+
+__songbird_header__
+void *__sb_pool_alloc_callback(void *context, size_t size) {
+	sb_pool_t *pool = (sb_pool_t *)context;
+	if(size > pool->block_size) {
+		return NULL;
+	}
+	return sb_pool_alloc(pool);
+}
+
+__songbird_header__
+void *__sb_pool_resize_callback(void *context, void *ptr, size_t size) {
+	sb_pool_t *pool = (sb_pool_t *)context;
+	if(ptr == NULL) {
+		return __sb_pool_alloc_callback(context, size);
+	}
+	/* a block cannot grow past the block size */
+	return size <= pool->block_size ? ptr : NULL;
+}
+
+__songbird_header__
+void __sb_pool_release_callback(void *context, void *ptr) {
+	sb_pool_release((sb_pool_t *)context, ptr);
+}
+
+__songbird_header__
+void sb_pool_init(sb_pool_t *pool, size_t block_size, unsigned blocks_per_slab) {
+	pool->allocator.alloc = __sb_pool_alloc_callback;
+	pool->allocator.resize = __sb_pool_resize_callback;
+	pool->allocator.release = __sb_pool_release_callback;
+	pool->allocator.context = pool;
+	pool->free_list = NULL;
+	pool->slabs = NULL;
+	/* a free block holds the link to the next one */
+	if(block_size < sizeof(void *)) {
+		block_size = sizeof(void *);
+	}
+	pool->block_size = __SB_ALLOC_ROUND(block_size);
+	pool->blocks_per_slab = blocks_per_slab ? blocks_per_slab : 64;
+}
+
+__songbird_header__
+void *sb_pool_alloc(sb_pool_t *pool) {
+	void *block = pool->free_list;
+	if(block == NULL) {
+		unsigned char *slab;
+		unsigned i;
+		if(pool->block_size > ((size_t)-1 - SB_ALLOC_ALIGN) / pool->blocks_per_slab) {
+			return NULL;
+		}
+		/* the first aligned block of a slab links the slabs together */
+		slab = (unsigned char *)sb_malloc(SB_ALLOC_ALIGN + pool->block_size * pool->blocks_per_slab);
+		if(slab == NULL) {
+			return NULL;
+		}
+		*(void **)slab = pool->slabs;
+		pool->slabs = slab;
+		for(i = pool->blocks_per_slab; i > 0; --i) {
+			block = slab + SB_ALLOC_ALIGN + pool->block_size * (i - 1);
+			*(void **)block = pool->free_list;
+			pool->free_list = block;
+		}
+		block = pool->free_list;
+	}
+	pool->free_list = *(void **)block;
+	return block;
+}
+
+__songbird_header__
+void sb_pool_release(sb_pool_t *pool, void *ptr) {
+	if(ptr == NULL) {
+		return;
+	}
+	*(void **)ptr = pool->free_list;
+	pool->free_list = ptr;
+}
+
+__songbird_header__
+void sb_pool_free(sb_pool_t *pool) {
+	void *slab = pool->slabs;
+	while(slab != NULL) {
+		void *next = *(void **)slab;
+		sb_free(slab);
+		slab = next;
+	}
+	pool->slabs = NULL;
+	pool->free_list = NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef __songbird_header__
+
+#endif /* __SONGBIRD_ALLOC_H__ */
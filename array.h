@@ -30,6 +30,29 @@
 #define sb_free free
 #endif /* __SB_NO_ALLOC__ */
 
+#ifndef __SB_ALLOCATOR__
+#define __SB_ALLOCATOR__
+#include <stddef.h>
+/*
+ * A runtime allocator, handed to a container when it is initialized. A NULL
+ * allocator stands for sb_malloc, sb_realloc and sb_free. The allocator has
+ * to outlive every container using it and release has to accept NULL.
+ * alloc.h provides arena and pool allocators.
+ */
+typedef struct sb_allocator {
+	void *(*alloc)(void *context, size_t size);
+	void *(*resize)(void *context, void *ptr, size_t size);
+	void (*release)(void *context, void *ptr);
+	void *context;
+} sb_allocator_t;
+#define __sb_allocate(a, size) \
+	((a) ? (a)->alloc((a)->context, (size)) : sb_malloc(size))
+#define __sb_reallocate(a, ptr, size) \
+	((a) ? (a)->resize((a)->context, (ptr), (size)) : sb_realloc((ptr), (size)))
+#define __sb_deallocate(a, ptr) \
+	((a) ? (a)->release((a)->context, (ptr)) : sb_free(ptr))
+#endif
+
 #ifdef __cplusplus
 /* Not sure why you would want to use this in C++, but just in case. */
 extern "C" {
@@ -62,6 +85,14 @@ int sb_error = SB_ERROR_NONE;
 typedef void (*sb_iter_f)(void const *);
 #endif
 
+#ifndef __songbird_each_func__
+#define __songbird_each_func__
+/** gets the context, a value and its index, non-zero stops the iteration */
+typedef int (*sb_each_f)(void *context, void const *value, unsigned index);
+/** gets count consecutive entries, the first at index, non-zero stops */
+typedef int (*sb_span_f)(void *context, void const **entries, unsigned count, unsigned index);
+#endif
+
 /**
  * @brief The array structure.
  * This is the structure used by the sb_array_* functions.
@@ -71,6 +102,7 @@ typedef void (*sb_iter_f)(void const *);
 typedef struct sb_array {
 	unsigned const size;
 	void const **entries;
+	sb_allocator_t const *allocator;
 } sb_array_t;
 
 
@@ -83,6 +115,18 @@ typedef struct sb_array {
 __songbird_header__
 void sb_array_init(sb_array_t *array, unsigned const size);
 
+/**
+ * Initializes the specified array, taking its memory from the given
+ * allocator. sb_error is set to SB_ERROR_MEMORY_ALLOCATION if the memory
+ * allocation fails.
+ * @param array The array to initialize.
+ * @param size The size of the array
+ * @param allocator The allocator, or NULL for sb_malloc.
+ */
+__songbird_header__
+void sb_array_init_alloc(sb_array_t *array, unsigned const size,
+		sb_allocator_t const *allocator);
+
 /**
  * Frees all allocated memory for the given array.
  * @param array The array to free.
@@ -133,12 +177,44 @@ void const *sb_array_set(sb_array_t *array, unsigned const index,
 __songbird_header__
 void sb_array_iterate(sb_array_t *array, sb_iter_f iter);
 
+/**
+ * Iterates through the given array calling the specified function with the
+ * context, every value and its index, until it returns non-zero.
+ * @param array The array.
+ * @param each The function to call, it must not be NULL.
+ * @param context Passed to each.
+ * @return The index at which each returned non-zero, or the size of the
+ * 		array if it never did.
+ */
+__songbird_header__
+unsigned sb_array_each(sb_array_t *array, sb_each_f each, void *context);
+
+/**
+ * Hands the entries of the given array to the specified function as
+ * contiguous spans, so the function can loop over them itself. All entries
+ * are one span, an empty array has none.
+ * @param array The array.
+ * @param span The function to call, it must not be NULL.
+ * @param context Passed to span.
+ * @return What span returned if it was non-zero, otherwise 0.
+ */
+__songbird_header__
+int sb_array_each_span(sb_array_t *array, sb_span_f span, void *context);
+
 /* function definitions */
 
 __songbird_header__
 void sb_array_init(sb_array_t *array, unsigned const size) {
+	sb_array_init_alloc(array, size, NULL);
+}
+
+__songbird_header__
+void sb_array_init_alloc(sb_array_t *array, unsigned const size,
+		sb_allocator_t const *allocator) {
 	*(unsigned *)&array->size = size;
-	array->entries = sb_malloc(size * sizeof(void *));
+	array->allocator = allocator;
+	array->entries = (void const **)__sb_allocate(allocator,
+			size * sizeof(void *));
 	if(array->entries == NULL) {
 		sb_error = SB_ERROR_MEMORY_ALLOCATION;
 	}
@@ -146,7 +222,7 @@ void sb_array_init(sb_array_t *array, unsigned const size) {
 
 __songbird_header__
 void sb_array_free(sb_array_t *array) {
-	sb_free(array->entries);
+	__sb_deallocate(array->allocator, (void *)array->entries);
 	array->entries = NULL;
 }
 
@@ -188,6 +264,25 @@ void sb_array_iterate(sb_array_t *array, sb_iter_f iterfun) {
 	}
 }
 
+__songbird_header__
+unsigned sb_array_each(sb_array_t *array, sb_each_f each, void *context) {
+	unsigned i = 0;
+	for(; i < array->size; ++i) {
+		if(each(context, array->entries[i], i)) {
+			break;
+		}
+	}
+	return i;
+}
+
+__songbird_header__
+int sb_array_each_span(sb_array_t *array, sb_span_f span, void *context) {
+	if(array->size == 0) {
+		return 0;
+	}
+	return span(context, array->entries, array->size, 0);
+}
+
 #undef __songbird_header__
 
 #ifdef __cplusplus
@@ -0,0 +1,633 @@
+/**
+ * Copyright (c) 2014-2017 Robert Maupin <chasesan@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SONGBIRD_ASYNC_H__
+#define __SONGBIRD_ASYNC_H__
+
+/*
+ * Asynchronous file reads and writes. Requests are queued, submitted
+ * together, and their completions collected later, so many reads can be in
+ * flight at once. Uses io_uring on Linux when the kernel allows it and a
+ * pool of worker threads everywhere else, define SB_ASYNC_NO_URING to
+ * always use the threads. POSIX only, link with -pthread.
+ */
+
+/*
+ * Strict C modes hide the POSIX and BSD functions used below. This asks for
+ * them, but only works if no system header was included before this file,
+ * otherwise compile with _DEFAULT_SOURCE defined.
+ */
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE) && !defined(_GNU_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__linux__) && !defined(SB_ASYNC_NO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define __SB_ASYNC_URING__
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+/* prefaulting the rings is only an optimisation */
+#ifdef MAP_POPULATE
+#define __SB_ASYNC_POPULATE	MAP_POPULATE
+#else
+#define __SB_ASYNC_POPULATE	0
+#endif
+#endif
+#endif
+
+#ifndef __SB_NO_ALLOC__
+#include <stdlib.h>
+#define sb_malloc malloc
+#define sb_realloc realloc
+#define sb_free free
+#endif /* __SB_NO_ALLOC__ */
+
+#ifdef __cplusplus
+/* Not sure why you would want to use this in C++, but just in case. */
+extern "C" {
+#define __songbird_header__	inline
+/* Works even if __STDC_VERSION__ is not defined. */
+#elif __STDC_VERSION__ <= 199409L
+#define __songbird_header__	static __inline__
+#else
+#define __songbird_header__	static inline
+#endif
+
+enum {
+	SB_ASYNC_READ = 0,
+	SB_ASYNC_WRITE = 1
+};
+
+enum {
+	SB_ASYNC_DEFAULT_DEPTH = 64,
+	SB_ASYNC_DEFAULT_THREADS = 4
+};
+
+/**
+ * @brief A single read or write.
+ * The request is owned by the caller and must stay valid until it has been
+ * returned by sb_async_poll or sb_async_wait. It is highly recommended you
+ * do not change any values in this structure manually.
+ */
+typedef struct sb_async_request {
+	int opcode;
+	int fd;
+	struct iovec iov;
+	off_t offset;
+	/* the number of bytes transferred, or -errno on failure */
+	int result;
+	/* for the caller */
+	void *data;
+	struct sb_async_request *next;
+} sb_async_request_t;
+
+/**
+ * @brief The submission queue.
+ * This is the structure used by the sb_async_* functions.
+ * It is highly recommended you do not change any values in this
+ * structure manually.
+ */
+typedef struct sb_async {
+	/* queued but not yet submitted */
+	sb_async_request_t *queued;
+	sb_async_request_t *queued_tail;
+	unsigned inflight;
+	int uring;
+#ifdef __SB_ASYNC_URING__
+	int ring;
+	unsigned depth;
+	void *sq_ptr;
+	void *cq_ptr;
+	size_t sq_size;
+	size_t cq_size;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned sqes_count;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+#endif
+	/* thread pool */
+	pthread_t *threads;
+	unsigned thread_count;
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+	sb_async_request_t *pending;
+	sb_async_request_t *pending_tail;
+	sb_async_request_t *completed;
+	sb_async_request_t *completed_tail;
+	int stop;
+} sb_async_t;
+
+/**
+ * Initializes the queue.
+ * @param async The queue to initialize.
+ * @param depth The most requests in flight at once, 0 for
+ * 		SB_ASYNC_DEFAULT_DEPTH.
+ * @param threads Worker threads to use without io_uring, 0 for
+ * 		SB_ASYNC_DEFAULT_THREADS.
+ * @return 0 on success, -1 on failure.
+ */
+__songbird_header__
+int sb_async_init(sb_async_t *async, unsigned depth, unsigned threads);
+
+/**
+ * Frees the queue. Requests still in flight are waited for first.
+ * @param async The queue to free.
+ */
+__songbird_header__
+void sb_async_free(sb_async_t *async);
+
+/**
+ * Queues a read of len bytes at offset into buf. At most INT_MAX bytes are
+ * read, so the count fits in the result.
+ * @param async The queue.
+ * @param request The request to fill in.
+ * @param data Stored in the request for the caller.
+ */
+__songbird_header__
+void sb_async_read(sb_async_t *async, sb_async_request_t *request,
+		int fd, void *buf, unsigned len, off_t offset, void *data);
+
+/**
+ * Queues a write of len bytes from buf at offset. At most INT_MAX bytes are
+ * written, so the count fits in the result.
+ * @param async The queue.
+ * @param request The request to fill in.
+ * @param data Stored in the request for the caller.
+ */
+__songbird_header__
+void sb_async_write(sb_async_t *async, sb_async_request_t *request,
+		int fd, void const *buf, unsigned len, off_t offset, void *data);
+
+/**
+ * Starts the queued requests, as many as the depth allows. The rest are
+ * started by later calls as earlier requests complete. Requests the kernel
+ * could not take when this fails are passed to it again by the next submit,
+ * poll or wait.
+ * @param async The queue.
+ * @return 0 on success, -1 on failure.
+ */
+__songbird_header__
+int sb_async_submit(sb_async_t *async);
+
+/**
+ * Collects finished requests without waiting.
+ * @param async The queue.
+ * @param done Filled with the finished requests.
+ * @param max The size of done.
+ * @return The number of requests stored in done.
+ */
+__songbird_header__
+unsigned sb_async_poll(sb_async_t *async, sb_async_request_t **done, unsigned max);
+
+/**
+ * Collects finished requests, waiting for at least one if any are in flight.
+ * @param async The queue.
+ * @param done Filled with the finished requests.
+ * @param max The size of done.
+ * @return The number of requests stored in done, 0 if nothing is pending.
+ */
+__songbird_header__
+unsigned sb_async_wait(sb_async_t *async, sb_async_request_t **done, unsigned max);
+
+/* function definitions */
+
+#ifdef __SB_ASYNC_URING__
+
+__songbird_header__
+int __sb_async_uring_init(sb_async_t *async, unsigned depth) {
+	struct io_uring_params params;
+	unsigned char *sq, *cq;
+	memset(&params, 0, sizeof(params));
+	async->ring = (int)syscall(__NR_io_uring_setup, depth, &params);
+	if(async->ring < 0) {
+		return -1; /* old kernel or not permitted */
+	}
+	async->depth = params.sq_entries;
+	async->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	async->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		if(async->cq_size > async->sq_size) {
+			async->sq_size = async->cq_size;
+		}
+		async->cq_size = 0;
+	}
+	async->sq_ptr = mmap(NULL, async->sq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | __SB_ASYNC_POPULATE, async->ring, IORING_OFF_SQ_RING);
+	if(async->sq_ptr == MAP_FAILED) {
+		close(async->ring);
+		return -1;
+	}
+	async->cq_ptr = async->sq_ptr;
+	if(async->cq_size) {
+		async->cq_ptr = mmap(NULL, async->cq_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | __SB_ASYNC_POPULATE, async->ring, IORING_OFF_CQ_RING);
+		if(async->cq_ptr == MAP_FAILED) {
+			munmap(async->sq_ptr, async->sq_size);
+			close(async->ring);
+			return -1;
+		}
+	}
+	async->sqes_count = params.sq_entries;
+	async->sqes = (struct io_uring_sqe *)mmap(NULL,
+			params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+			MAP_SHARED | __SB_ASYNC_POPULATE, async->ring, IORING_OFF_SQES);
+	if(async->sqes == MAP_FAILED) {
+		if(async->cq_size) {
+			munmap(async->cq_ptr, async->cq_size);
+		}
+		munmap(async->sq_ptr, async->sq_size);
+		close(async->ring);
+		return -1;
+	}
+	sq = (unsigned char *)async->sq_ptr;
+	cq = (unsigned char *)async->cq_ptr;
+	async->sq_head = (unsigned *)(sq + params.sq_off.head);
+	async->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+	async->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+	async->sq_array = (unsigned *)(sq + params.sq_off.array);
+	async->cq_head = (unsigned *)(cq + params.cq_off.head);
+	async->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+	async->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+	async->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+	return 0;
+}
+
+__songbird_header__
+void __sb_async_uring_free(sb_async_t *async) {
+	munmap(async->sqes, async->sqes_count * sizeof(struct io_uring_sqe));
+	if(async->cq_size) {
+		munmap(async->cq_ptr, async->cq_size);
+	}
+	munmap(async->sq_ptr, async->sq_size);
+	close(async->ring);
+}
+
+/**
+ * Returns the number of entries in the submission ring the kernel has not
+ * taken yet, left there by a failed or short io_uring_enter. This function
+ * is not designed to be called by the end user.
+ */
+__songbird_header__
+unsigned __sb_async_uring_unsubmitted(sb_async_t *async) {
+	return *async->sq_tail - __atomic_load_n(async->sq_head, __ATOMIC_ACQUIRE);
+}
+
+__songbird_header__
+int __sb_async_uring_submit(sb_async_t *async) {
+	unsigned tail = *async->sq_tail;
+	unsigned mask = *async->sq_mask;
+	unsigned count = 0;
+	unsigned index;
+	struct io_uring_sqe *sqe;
+	sb_async_request_t *request;
+	/* never more in flight than the completion ring can hold */
+	while(async->queued && async->inflight < async->depth) {
+		request = async->queued;
+		async->queued = request->next;
+		index = tail & mask;
+		sqe = &async->sqes[index];
+		memset(sqe, 0, sizeof(struct io_uring_sqe));
+		/* readv and writev work on every kernel with io_uring */
+		sqe->opcode = request->opcode == SB_ASYNC_READ ? IORING_OP_READV : IORING_OP_WRITEV;
+		sqe->fd = request->fd;
+		sqe->addr = (uint64_t)(uintptr_t)&request->iov;
+		sqe->len = 1;
+		sqe->off = (uint64_t)request->offset;
+		sqe->user_data = (uint64_t)(uintptr_t)request;
+		async->sq_array[index] = index;
+		++tail;
+		++count;
+		++async->inflight;
+	}
+	if(async->queued == NULL) {
+		async->queued_tail = NULL;
+	}
+	if(count > 0) {
+		/* the kernel must see the entries before the new tail */
+		__atomic_store_n(async->sq_tail, tail, __ATOMIC_RELEASE);
+	}
+	/* entries an earlier call could not hand over are passed again */
+	count = __sb_async_uring_unsubmitted(async);
+	if(count == 0) {
+		return 0;
+	}
+	while(syscall(__NR_io_uring_enter, async->ring, count, 0, 0, NULL, 0) < 0) {
+		if(errno != EINTR) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+__songbird_header__
+unsigned __sb_async_uring_reap(sb_async_t *async, sb_async_request_t **done, unsigned max, int wait) {
+	unsigned head, count = 0;
+	struct io_uring_cqe *cqe;
+	sb_async_request_t *request;
+	for(;;) {
+		head = *async->cq_head;
+		while(count < max && head != __atomic_load_n(async->cq_tail, __ATOMIC_ACQUIRE)) {
+			cqe = &async->cqes[head & *async->cq_mask];
+			request = (sb_async_request_t *)(uintptr_t)cqe->user_data;
+			request->result = cqe->res;
+			done[count++] = request;
+			++head;
+			--async->inflight;
+		}
+		__atomic_store_n(async->cq_head, head, __ATOMIC_RELEASE);
+		if(count > 0 || !wait || async->inflight == 0) {
+			return count;
+		}
+		/* nothing completes until the entries still in the ring are taken */
+		if(syscall(__NR_io_uring_enter, async->ring, __sb_async_uring_unsubmitted(async),
+				1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+			return count;
+		}
+	}
+}
+
+#endif /* __SB_ASYNC_URING__ */
+
+__songbird_header__
+void __sb_async_execute(sb_async_request_t *request) {
+	ssize_t result;
+	do {
+		if(request->opcode == SB_ASYNC_READ) {
+			result = pread(request->fd, request->iov.iov_base, request->iov.iov_len, request->offset);
+		} else {
+			result = pwrite(request->fd, request->iov.iov_base, request->iov.iov_len, request->offset);
+		}
+	} while(result < 0 && errno == EINTR);
+	request->result = result < 0 ? -errno : (int)result;
+}
+
+__songbird_header__
+void *__sb_async_worker(void *arg) {
+	sb_async_t *async = (sb_async_t *)arg;
+	sb_async_request_t *request;
+	pthread_mutex_lock(&async->lock);
+	for(;;) {
+		while(async->pending == NULL && !async->stop) {
+			pthread_cond_wait(&async->work, &async->lock);
+		}
+		if(async->pending == NULL) {
+			break;
+		}
+		request = async->pending;
+		async->pending = request->next;
+		if(async->pending == NULL) {
+			async->pending_tail = NULL;
+		}
+		pthread_mutex_unlock(&async->lock);
+		__sb_async_execute(request);
+		pthread_mutex_lock(&async->lock);
+		request->next = NULL;
+		if(async->completed_tail) {
+			async->completed_tail->next = request;
+		} else {
+			async->completed = request;
+		}
+		async->completed_tail = request;
+		pthread_cond_signal(&async->done);
+	}
+	pthread_mutex_unlock(&async->lock);
+	return NULL;
+}
+
+__songbird_header__
+int sb_async_init(sb_async_t *async, unsigned depth, unsigned threads) {
+	unsigned i;
+	memset(async, 0, sizeof(sb_async_t));
+	if(depth == 0) {
+		depth = SB_ASYNC_DEFAULT_DEPTH;
+	}
+	if(threads == 0) {
+		threads = SB_ASYNC_DEFAULT_THREADS;
+	}
+#ifdef __SB_ASYNC_URING__
+	if(__sb_async_uring_init(async, depth) == 0) {
+		async->uring = 1;
+		return 0;
+	}
+#endif
+	if(pthread_mutex_init(&async->lock, NULL)) {
+		return -1;
+	}
+	pthread_cond_init(&async->work, NULL);
+	pthread_cond_init(&async->done, NULL);
+	async->threads = (pthread_t *)sb_malloc(sizeof(pthread_t) * threads);
+	if(async->threads == NULL) {
+		sb_async_free(async);
+		return -1;
+	}
+	for(i = 0; i < threads; ++i) {
+		if(pthread_create(&async->threads[i], NULL, __sb_async_worker, async)) {
+			break;
+		}
+		++async->thread_count;
+	}
+	if(async->thread_count == 0) {
+		sb_async_free(async);
+		return -1;
+	}
+	return 0;
+}
+
+__songbird_header__
+void sb_async_free(sb_async_t *async) {
+	unsigned i;
+#ifdef __SB_ASYNC_URING__
+	if(async->uring) {
+		sb_async_request_t *done[SB_ASYNC_DEFAULT_DEPTH];
+		/* the kernel may still write into the requests */
+		while(async->inflight > 0) {
+			__sb_async_uring_reap(async, done, SB_ASYNC_DEFAULT_DEPTH, 1);
+		}
+		__sb_async_uring_free(async);
+		async->uring = 0;
+		return;
+	}
+#endif
+	pthread_mutex_lock(&async->lock);
+	async->stop = 1;
+	pthread_cond_broadcast(&async->work);
+	pthread_mutex_unlock(&async->lock);
+	/* workers finish everything pending before they exit */
+	for(i = 0; i < async->thread_count; ++i) {
+		pthread_join(async->threads[i], NULL);
+	}
+	sb_free(async->threads);
+	async->threads = NULL;
+	async->thread_count = 0;
+	pthread_cond_destroy(&async->work);
+	pthread_cond_destroy(&async->done);
+	pthread_mutex_destroy(&async->lock);
+}
+
+__songbird_header__
+void __sb_async_queue(sb_async_t *async, sb_async_request_t *request) {
+	request->next = NULL;
+	request->result = 0;
+	if(async->queued_tail) {
+		async->queued_tail->next = request;
+	} else {
+		async->queued = request;
+	}
+	async->queued_tail = request;
+}
+
+__songbird_header__
+void sb_async_read(sb_async_t *async, sb_async_request_t *request,
+		int fd, void *buf, unsigned len, off_t offset, void *data) {
+	request->opcode = SB_ASYNC_READ;
+	request->fd = fd;
+	request->iov.iov_base = buf;
+	/* the result has to fit in an int */
+	request->iov.iov_len = len > INT_MAX ? INT_MAX : len;
+	request->offset = offset;
+	request->data = data;
+	__sb_async_queue(async, request);
+}
+
+__songbird_header__
+void sb_async_write(sb_async_t *async, sb_async_request_t *request,
+		int fd, void const *buf, unsigned len, off_t offset, void *data) {
+	request->opcode = SB_ASYNC_WRITE;
+	request->fd = fd;
+	request->iov.iov_base = (void *)buf;
+	request->iov.iov_len = len > INT_MAX ? INT_MAX : len;
+	request->offset = offset;
+	request->data = data;
+	__sb_async_queue(async, request);
+}
+
+__songbird_header__
+int sb_async_submit(sb_async_t *async) {
+	sb_async_request_t *request;
+#ifdef __SB_ASYNC_URING__
+	if(async->uring) {
+		return __sb_async_uring_submit(async);
+	}
+#endif
+	if(async->queued == NULL) {
+		return 0;
+	}
+	pthread_mutex_lock(&async->lock);
+	for(request = async->queued; request; request = request->next) {
+		++async->inflight;
+	}
+	if(async->pending_tail) {
+		async->pending_tail->next = async->queued;
+	} else {
+		async->pending = async->queued;
+	}
+	async->pending_tail = async->queued_tail;
+	pthread_cond_broadcast(&async->work);
+	pthread_mutex_unlock(&async->lock);
+	async->queued = NULL;
+	async->queued_tail = NULL;
+	return 0;
+}
+
+/**
+ * Takes up to max finished requests off the thread pool's list, waiting
+ * for one first if asked to. This function is not designed to be called by
+ * the end user.
+ */
+__songbird_header__
+unsigned __sb_async_collect(sb_async_t *async, sb_async_request_t **done, unsigned max, int wait) {
+	unsigned count = 0;
+	pthread_mutex_lock(&async->lock);
+	if(wait) {
+		while(async->completed == NULL && async->inflight > 0) {
+			pthread_cond_wait(&async->done, &async->lock);
+		}
+	}
+	while(count < max && async->completed) {
+		done[count++] = async->completed;
+		async->completed = async->completed->next;
+		--async->inflight;
+	}
+	if(async->completed == NULL) {
+		async->completed_tail = NULL;
+	}
+	pthread_mutex_unlock(&async->lock);
+	return count;
+}
+
+__songbird_header__
+unsigned sb_async_poll(sb_async_t *async, sb_async_request_t **done, unsigned max) {
+	unsigned count;
+#ifdef __SB_ASYNC_URING__
+	if(async->uring) {
+		count = __sb_async_uring_reap(async, done, max, 0);
+		/* top up the ring with anything that did not fit before */
+		__sb_async_uring_submit(async);
+		return count;
+	}
+#endif
+	count = __sb_async_collect(async, done, max, 0);
+	return count;
+}
+
+__songbird_header__
+unsigned sb_async_wait(sb_async_t *async, sb_async_request_t **done, unsigned max) {
+	unsigned count;
+	sb_async_submit(async);
+#ifdef __SB_ASYNC_URING__
+	if(async->uring) {
+		count = __sb_async_uring_reap(async, done, max, 1);
+		__sb_async_uring_submit(async);
+		return count;
+	}
+#endif
+	count = __sb_async_collect(async, done, max, 1);
+	return count;
+}
+
+#undef __songbird_header__
+#ifdef __SB_ASYNC_POPULATE
+#undef __SB_ASYNC_POPULATE
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SONGBIRD_ASYNC_H__ */
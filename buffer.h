@@ -23,6 +23,16 @@
 #ifndef __SONGBIRD_BUFFER_H__
 #define __SONGBIRD_BUFFER_H__
 
+#include <string.h>
+#include <stdint.h>
+
+/* Define SB_BUFFER_NO_SIMD to use only the portable scanning code. */
+#if !defined(SB_BUFFER_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) \
+	&& (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define __SB_BUFFER_SSE2__
+#include <immintrin.h>
+#endif
+
 #ifndef __SB_NO_ALLOC__
 #include <stdlib.h>
 #define sb_malloc malloc
@@ -30,6 +40,29 @@
 #define sb_free free
 #endif /* __SB_NO_ALLOC__ */
 
+#ifndef __SB_ALLOCATOR__
+#define __SB_ALLOCATOR__
+#include <stddef.h>
+/*
+ * A runtime allocator, handed to a container when it is initialized. A NULL
+ * allocator stands for sb_malloc, sb_realloc and sb_free. The allocator has
+ * to outlive every container using it and release has to accept NULL.
+ * alloc.h provides arena and pool allocators.
+ */
+typedef struct sb_allocator {
+	void *(*alloc)(void *context, size_t size);
+	void *(*resize)(void *context, void *ptr, size_t size);
+	void (*release)(void *context, void *ptr);
+	void *context;
+} sb_allocator_t;
+#define __sb_allocate(a, size) \
+	((a) ? (a)->alloc((a)->context, (size)) : sb_malloc(size))
+#define __sb_reallocate(a, ptr, size) \
+	((a) ? (a)->resize((a)->context, (ptr), (size)) : sb_realloc((ptr), (size)))
+#define __sb_deallocate(a, ptr) \
+	((a) ? (a)->release((a)->context, (ptr)) : sb_free(ptr))
+#endif
+
 #ifdef __cplusplus
 /* Not sure why you would want to use this in C++, but just in case. */
 extern "C" {
@@ -41,17 +74,48 @@ extern "C" {
 #define __songbird_header__	static inline
 #endif
 
+enum {
+	SB_BUFFER_OK = 0,
+	SB_BUFFER_ERROR = -1,
+	SB_BUFFER_SHORT = -2,
+	SB_BUFFER_OVERFLOW = -3
+};
+
 /* It is highly recommended you do not change any values in this structure manually */
 typedef struct {
 	unsigned const size;
 	unsigned const capacity;
 	unsigned const index;
 	unsigned char const *data;
+	unsigned const stream;
+	unsigned *refs;
+	sb_allocator_t const *allocator;
 } sb_buffer_t;
 
+/*
+ * A read only view into the storage of a buffer. Slices share the bytes
+ * with the buffer and each other through a reference count, so handing the
+ * same message to several readers does not copy it. The buffer never writes
+ * over bytes that a slice can see, it moves to fresh storage instead. The
+ * reference count is not atomic, slices must stay on one thread.
+ */
+typedef struct {
+	unsigned const size;
+	unsigned char const *data;
+	void *storage;
+	unsigned *refs;
+	sb_allocator_t const *allocator;
+} sb_buffer_slice_t;
+
 /** creates a new buffer */
 __songbird_header__	sb_buffer_t *sb_buffer_alloc();
 
+/**
+ * creates a new buffer that takes all of its memory, itself included, from
+ * the given allocator, NULL stands for sb_malloc
+ */
+__songbird_header__	sb_buffer_t *sb_buffer_alloc_with(sb_allocator_t const *);
+
 /** disposes of the buffer */
 __songbird_header__	void sb_buffer_free(sb_buffer_t *);
 
@@ -73,40 +137,253 @@ __songbird_header__	int sb_buffer_fget(sb_buffer_t *);
 /** sets the read index to the given index */
 __songbird_header__	void sb_buffer_fseek(sb_buffer_t *, unsigned);
 
+/** makes room for at least the given number of bytes past the end, returns -1 on allocation failure */
+__songbird_header__	int sb_buffer_reserve(sb_buffer_t *, unsigned);
+
+/** adds the given bytes to the buffer, returns -1 on allocation failure */
+__songbird_header__	int sb_buffer_append(sb_buffer_t *, void const *, unsigned);
+
+/** copies up to the given number of bytes from the read index, returns the number of bytes read */
+__songbird_header__	unsigned sb_buffer_read(sb_buffer_t *, void *, unsigned);
+
+/** returns a writable pointer to at least the given number of bytes past the end, NULL on allocation failure */
+__songbird_header__	unsigned char *sb_buffer_prepare(sb_buffer_t *, unsigned);
+
+/** adds the given number of bytes written through sb_buffer_prepare to the buffer */
+__songbird_header__	void sb_buffer_commit(sb_buffer_t *, unsigned);
+
+/*
+ * Streaming mode. A streaming buffer moves the unread bytes to the front
+ * whenever it runs out of room, and starts over from 0 once everything has
+ * been consumed, so the storage is reused instead of growing forever. Since
+ * the bytes move, indexes given to sb_buffer_get, sb_buffer_set and
+ * sb_buffer_fseek are only valid until the next write.
+ */
+
+/** enables or disables streaming mode */
+__songbird_header__	void sb_buffer_set_stream(sb_buffer_t *, int);
+
+/** advances the read index by up to the given number of bytes, returns the number of bytes consumed */
+__songbird_header__	unsigned sb_buffer_consume(sb_buffer_t *, unsigned);
+
+/** moves the unread bytes to the start of the buffer */
+__songbird_header__	void sb_buffer_compact(sb_buffer_t *);
+
+/** compacts the buffer and releases any capacity not needed by the unread bytes */
+__songbird_header__	void sb_buffer_shrink(sb_buffer_t *);
+
+/** returns the unread bytes and their length, for writev and the like */
+__songbird_header__	unsigned char const *sb_buffer_peek(sb_buffer_t *, unsigned *);
+
+/** returns the free space past the end and its length without growing, for readv and the like */
+__songbird_header__	unsigned char *sb_buffer_tail(sb_buffer_t *, unsigned *);
+
+/** creates a slice of the given bytes, returns SB_BUFFER_ERROR on allocation failure */
+__songbird_header__	int sb_buffer_slice(sb_buffer_t *, unsigned, unsigned, sb_buffer_slice_t *);
+
+/** creates a slice of part of another slice */
+__songbird_header__	void sb_buffer_slice_sub(sb_buffer_slice_t *, unsigned, unsigned, sb_buffer_slice_t *);
+
+/** creates another reference to the same bytes */
+__songbird_header__	void sb_buffer_slice_retain(sb_buffer_slice_t *, sb_buffer_slice_t *);
+
+/** drops the reference, the storage is freed with the last one */
+__songbird_header__	void sb_buffer_slice_release(sb_buffer_slice_t *);
+
+/** returns a writable pointer to the bytes, copying them first if they are shared, NULL on allocation failure */
+__songbird_header__	unsigned char *sb_buffer_slice_mutable(sb_buffer_slice_t *);
+
+/*
+ * Scanning. These search the unread bytes, from the read index to the end,
+ * and return the index of the first match or -1 if there is none. They use
+ * SSE2, or AVX2 when the processor supports it, and fall back to word at a
+ * time scanning elsewhere.
+ */
+
+/** finds the given byte */
+__songbird_header__	int sb_buffer_find_byte(sb_buffer_t *, int);
+
+/** finds any of the given bytes */
+__songbird_header__	int sb_buffer_find_any(sb_buffer_t *, void const *, unsigned);
+
+/** finds the given sequence of bytes */
+__songbird_header__	int sb_buffer_find_seq(sb_buffer_t *, void const *, unsigned);
+
+/*
+ * Typed encoding. The put functions add the value to the end of the buffer
+ * and return SB_BUFFER_OK, or SB_BUFFER_ERROR on allocation failure. The get
+ * functions decode from the read index and return SB_BUFFER_OK, or
+ * SB_BUFFER_SHORT if the whole value is not in the buffer yet, in which case
+ * the read index is left untouched so the read can be retried once more
+ * bytes arrive.
+ */
+__songbird_header__	int sb_buffer_put_u8(sb_buffer_t *, uint8_t);
+__songbird_header__	int sb_buffer_put_u16le(sb_buffer_t *, uint16_t);
+__songbird_header__	int sb_buffer_put_u16be(sb_buffer_t *, uint16_t);
+__songbird_header__	int sb_buffer_put_u32le(sb_buffer_t *, uint32_t);
+__songbird_header__	int sb_buffer_put_u32be(sb_buffer_t *, uint32_t);
+__songbird_header__	int sb_buffer_put_u64le(sb_buffer_t *, uint64_t);
+__songbird_header__	int sb_buffer_put_u64be(sb_buffer_t *, uint64_t);
+__songbird_header__	int sb_buffer_put_f32le(sb_buffer_t *, float);
+__songbird_header__	int sb_buffer_put_f32be(sb_buffer_t *, float);
+__songbird_header__	int sb_buffer_put_f64le(sb_buffer_t *, double);
+__songbird_header__	int sb_buffer_put_f64be(sb_buffer_t *, double);
+/** LEB128, at most 10 bytes */
+__songbird_header__	int sb_buffer_put_varint(sb_buffer_t *, uint64_t);
+/** zigzag encoded LEB128, small negative numbers stay small */
+__songbird_header__	int sb_buffer_put_svarint(sb_buffer_t *, int64_t);
+/** varint length followed by the bytes */
+__songbird_header__	int sb_buffer_put_bytes(sb_buffer_t *, void const *, unsigned);
+
+__songbird_header__	int sb_buffer_get_u8(sb_buffer_t *, uint8_t *);
+__songbird_header__	int sb_buffer_get_u16le(sb_buffer_t *, uint16_t *);
+__songbird_header__	int sb_buffer_get_u16be(sb_buffer_t *, uint16_t *);
+__songbird_header__	int sb_buffer_get_u32le(sb_buffer_t *, uint32_t *);
+__songbird_header__	int sb_buffer_get_u32be(sb_buffer_t *, uint32_t *);
+__songbird_header__	int sb_buffer_get_u64le(sb_buffer_t *, uint64_t *);
+__songbird_header__	int sb_buffer_get_u64be(sb_buffer_t *, uint64_t *);
+__songbird_header__	int sb_buffer_get_f32le(sb_buffer_t *, float *);
+__songbird_header__	int sb_buffer_get_f32be(sb_buffer_t *, float *);
+__songbird_header__	int sb_buffer_get_f64le(sb_buffer_t *, double *);
+__songbird_header__	int sb_buffer_get_f64be(sb_buffer_t *, double *);
+/** also returns SB_BUFFER_OVERFLOW if the varint does not fit 64 bits */
+__songbird_header__	int sb_buffer_get_varint(sb_buffer_t *, uint64_t *);
+__songbird_header__	int sb_buffer_get_svarint(sb_buffer_t *, int64_t *);
+/** points at the bytes inside the buffer, they are not copied */
+__songbird_header__	int sb_buffer_get_bytes(sb_buffer_t *, unsigned char const **, unsigned *);
+
 __songbird_header__
 sb_buffer_t *sb_buffer_alloc() {
-	sb_buffer_t *buffer = sb_malloc(sizeof(sb_buffer_t));
+	return sb_buffer_alloc_with(NULL);
+}
+
+__songbird_header__
+sb_buffer_t *sb_buffer_alloc_with(sb_allocator_t const *allocator) {
+	sb_buffer_t *buffer = (sb_buffer_t *)__sb_allocate(allocator, sizeof(sb_buffer_t));
+	if(buffer == NULL) {
+		return NULL;
+	}
+	buffer->allocator = allocator;
 	*(unsigned *)&buffer->size = 0;
 	*(unsigned *)&buffer->index = 0;
 	*(unsigned *)&buffer->capacity = 16;
-	buffer->data = (unsigned char const *)sb_malloc(sizeof(unsigned char) * buffer->capacity);
+	*(unsigned *)&buffer->stream = 0;
+	buffer->refs = NULL;
+	buffer->data = (unsigned char const *)__sb_allocate(allocator, sizeof(unsigned char) * buffer->capacity);
 	return buffer;
 }
 
 __songbird_header__
 void sb_buffer_free(sb_buffer_t *buffer) {
-	if(buffer->capacity > 0) {
-		sb_free((void *)buffer->data);
+	if(buffer->refs) {
+		if(--*buffer->refs == 0) {
+			__sb_deallocate(buffer->allocator, (void *)buffer->data);
+			__sb_deallocate(buffer->allocator, buffer->refs);
+		}
+	} else if(buffer->capacity > 0) {
+		__sb_deallocate(buffer->allocator, (void *)buffer->data);
 	}
-	sb_free(buffer);
+	__sb_deallocate(buffer->allocator, buffer);
 }
 
+/**
+ * Makes sure no slice can see the storage before it is written over. If
+ * slices still hold it the buffer moves to new storage, taking the given
+ * range of bytes along to the start of it. Returns -1 on allocation failure.
+ */
 __songbird_header__
-void __sb_buffer_resize(sb_buffer_t *buffer) {
-	/* double size */
-	unsigned new_capacity = buffer->capacity * 2;
-	unsigned char *new_data = (unsigned char *)sb_realloc((void *)buffer->data, sizeof(unsigned char) * new_capacity);
+int __sb_buffer_unshare(sb_buffer_t *buffer, unsigned offset, unsigned len) {
+	unsigned char *new_data;
+	if(buffer->refs == NULL) {
+		return 0;
+	}
+	if(*buffer->refs == 1) {
+		/* every slice is gone, the storage is ours again */
+		__sb_deallocate(buffer->allocator, buffer->refs);
+		buffer->refs = NULL;
+		return 0;
+	}
+	new_data = (unsigned char *)__sb_allocate(buffer->allocator, sizeof(unsigned char) * buffer->capacity);
 	if(new_data == NULL) {
-		return; /** FAILURE! */
+		return -1;
+	}
+	memcpy(new_data, buffer->data + offset, len);
+	--*buffer->refs;
+	buffer->refs = NULL;
+	buffer->data = new_data;
+	return 0;
+}
+
+/**
+ * Moves the unread bytes to the start of the storage. Returns -1, leaving
+ * the buffer as it was, if slices share the storage and new storage could
+ * not be allocated. This function is not designed to be called by the end
+ * user.
+ */
+__songbird_header__
+int __sb_buffer_compact(sb_buffer_t *buffer) {
+	unsigned remaining = 0;
+	if(buffer->index == 0) {
+		return 0;
+	}
+	if(buffer->index < buffer->size) {
+		remaining = buffer->size - buffer->index;
+	}
+	if(buffer->refs && *buffer->refs > 1) {
+		/* moving to new storage compacts for free */
+		if(__sb_buffer_unshare(buffer, buffer->index, remaining)) {
+			return -1;
+		}
+	} else {
+		__sb_buffer_unshare(buffer, 0, 0);
+		memmove((void *)buffer->data, buffer->data + buffer->index, remaining);
+	}
+	*(unsigned *)&buffer->size = remaining;
+	*(unsigned *)&buffer->index = 0;
+	return 0;
+}
+
+__songbird_header__
+int __sb_buffer_resize(sb_buffer_t *buffer, unsigned needed) {
+	/* double size until it fits, so a bulk operation only reallocates once */
+	unsigned new_capacity = buffer->capacity ? buffer->capacity : 16;
+	unsigned char *new_data;
+	while(new_capacity < needed) {
+		if(new_capacity * 2 < new_capacity) {
+			new_capacity = needed;
+			break;
+		}
+		new_capacity *= 2;
+	}
+	if(buffer->refs && *buffer->refs > 1) {
+		/* slices still point at the old storage, copy instead of moving it */
+		new_data = (unsigned char *)__sb_allocate(buffer->allocator, sizeof(unsigned char) * new_capacity);
+		if(new_data == NULL) {
+			return -1; /** FAILURE! */
+		}
+		memcpy(new_data, buffer->data, buffer->size);
+		--*buffer->refs;
+		buffer->refs = NULL;
+	} else {
+		if(__sb_buffer_unshare(buffer, 0, 0)) {
+			return -1;
+		}
+		new_data = (unsigned char *)__sb_reallocate(buffer->allocator, (void *)buffer->data, sizeof(unsigned char) * new_capacity);
+		if(new_data == NULL) {
+			return -1; /** FAILURE! */
+		}
 	}
 	buffer->data = new_data;
 	*(unsigned *)&buffer->capacity = new_capacity;
+	return 0;
 }
 
 __songbird_header__
 void sb_buffer_add(sb_buffer_t *buffer, int value) {
-	if(buffer->size + 1 == buffer->capacity) {
-		__sb_buffer_resize(buffer);
+	if(buffer->size == buffer->capacity) {
+		if(sb_buffer_reserve(buffer, 1)) {
+			return;
+		}
 	}
 	((unsigned char *)buffer->data)[buffer->size] = value & 0xff;
 	*(unsigned *)&buffer->size += 1;
@@ -126,6 +403,9 @@ int sb_buffer_set(sb_buffer_t *buffer, unsigned index, int value) {
 	if(index >= buffer->size) {
 		return -1;
 	}
+	if(__sb_buffer_unshare(buffer, 0, buffer->size)) {
+		return -1;
+	}
 	retval = buffer->data[index];
 	((unsigned char *)buffer->data)[index] = value & 0xff;
 	return retval;
@@ -133,6 +413,9 @@ int sb_buffer_set(sb_buffer_t *buffer, unsigned index, int value) {
 
 __songbird_header__
 void sb_buffer_reset(sb_buffer_t *buffer) {
+	if(__sb_buffer_unshare(buffer, 0, 0)) {
+		return;
+	}
 	*(unsigned *)&buffer->size = 0;
 }
 
@@ -150,6 +433,816 @@ void sb_buffer_fseek(sb_buffer_t *buffer, unsigned index) {
 	*(unsigned *)&buffer->index = index;
 }
 
+__songbird_header__
+int sb_buffer_reserve(sb_buffer_t *buffer, unsigned len) {
+	unsigned needed = buffer->size + len;
+	if(needed < buffer->size) {
+		return -1; /* overflow */
+	}
+	if(needed > buffer->capacity) {
+		/* reuse the consumed space before growing */
+		if(buffer->stream && buffer->index > 0
+				&& __sb_buffer_compact(buffer) == 0) {
+			needed = buffer->size + len;
+			if(needed <= buffer->capacity) {
+				return 0;
+			}
+		}
+		return __sb_buffer_resize(buffer, needed);
+	}
+	return 0;
+}
+
+__songbird_header__
+int sb_buffer_append(sb_buffer_t *buffer, void const *ptr, unsigned len) {
+	if(sb_buffer_reserve(buffer, len)) {
+		return -1;
+	}
+	memcpy((unsigned char *)buffer->data + buffer->size, ptr, len);
+	*(unsigned *)&buffer->size += len;
+	return 0;
+}
+
+__songbird_header__
+unsigned sb_buffer_read(sb_buffer_t *buffer, void *out, unsigned len) {
+	unsigned available;
+	if(buffer->index >= buffer->size) {
+		return 0;
+	}
+	available = buffer->size - buffer->index;
+	if(len > available) {
+		len = available;
+	}
+	memcpy(out, buffer->data + buffer->index, len);
+	*(unsigned *)&buffer->index += len;
+	return len;
+}
+
+__songbird_header__
+unsigned char *sb_buffer_prepare(sb_buffer_t *buffer, unsigned len) {
+	if(sb_buffer_reserve(buffer, len)) {
+		return NULL;
+	}
+	return (unsigned char *)buffer->data + buffer->size;
+}
+
+__songbird_header__
+void sb_buffer_commit(sb_buffer_t *buffer, unsigned len) {
+	if(len > buffer->capacity - buffer->size) {
+		len = buffer->capacity - buffer->size;
+	}
+	*(unsigned *)&buffer->size += len;
+}
+
+__songbird_header__
+void sb_buffer_set_stream(sb_buffer_t *buffer, int stream) {
+	*(unsigned *)&buffer->stream = stream != 0;
+}
+
+__songbird_header__
+unsigned sb_buffer_consume(sb_buffer_t *buffer, unsigned len) {
+	unsigned available = 0;
+	if(buffer->index < buffer->size) {
+		available = buffer->size - buffer->index;
+	}
+	if(len > available) {
+		len = available;
+	}
+	*(unsigned *)&buffer->index += len;
+	if(buffer->stream && buffer->index >= buffer->size) {
+		/* drained, start over without moving anything */
+		if(__sb_buffer_unshare(buffer, 0, 0)) {
+			return len;
+		}
+		*(unsigned *)&buffer->index = 0;
+		*(unsigned *)&buffer->size = 0;
+	}
+	return len;
+}
+
+__songbird_header__
+void sb_buffer_compact(sb_buffer_t *buffer) {
+	__sb_buffer_compact(buffer);
+}
+
+__songbird_header__
+void sb_buffer_shrink(sb_buffer_t *buffer) {
+	unsigned new_capacity = 16;
+	unsigned char *new_data;
+	sb_buffer_compact(buffer);
+	while(new_capacity <= buffer->size && new_capacity * 2 > new_capacity) {
+		new_capacity *= 2;
+	}
+	if(new_capacity >= buffer->capacity) {
+		return;
+	}
+	if(__sb_buffer_unshare(buffer, 0, buffer->size)) {
+		return;
+	}
+	new_data = (unsigned char *)__sb_reallocate(buffer->allocator, (void *)buffer->data, sizeof(unsigned char) * new_capacity);
+	if(new_data == NULL) {
+		return; /* the old storage is still valid */
+	}
+	buffer->data = new_data;
+	*(unsigned *)&buffer->capacity = new_capacity;
+}
+
+__songbird_header__
+unsigned char const *sb_buffer_peek(sb_buffer_t *buffer, unsigned *len) {
+	*len = 0;
+	if(buffer->index < buffer->size) {
+		*len = buffer->size - buffer->index;
+	}
+	return buffer->data + buffer->index;
+}
+
+__songbird_header__
+unsigned char *sb_buffer_tail(sb_buffer_t *buffer, unsigned *len) {
+	*len = buffer->capacity - buffer->size;
+	return (unsigned char *)buffer->data + buffer->size;
+}
+
+/* Slices */
+
+__songbird_header__
+int sb_buffer_slice(sb_buffer_t *buffer, unsigned offset, unsigned len, sb_buffer_slice_t *slice) {
+	if(offset > buffer->size) {
+		offset = buffer->size;
+	}
+	if(len > buffer->size - offset) {
+		len = buffer->size - offset;
+	}
+	if(buffer->refs == NULL) {
+		/* first slice, the buffer itself holds one reference */
+		buffer->refs = (unsigned *)__sb_allocate(buffer->allocator, sizeof(unsigned));
+		if(buffer->refs == NULL) {
+			return SB_BUFFER_ERROR;
+		}
+		*buffer->refs = 1;
+	}
+	++*buffer->refs;
+	*(unsigned *)&slice->size = len;
+	slice->data = buffer->data + offset;
+	slice->storage = (void *)buffer->data;
+	slice->refs = buffer->refs;
+	slice->allocator = buffer->allocator;
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+void sb_buffer_slice_sub(sb_buffer_slice_t *slice, unsigned offset, unsigned len, sb_buffer_slice_t *sub) {
+	if(offset > slice->size) {
+		offset = slice->size;
+	}
+	if(len > slice->size - offset) {
+		len = slice->size - offset;
+	}
+	sb_buffer_slice_retain(slice, sub);
+	*(unsigned *)&sub->size = len;
+	sub->data += offset;
+}
+
+__songbird_header__
+void sb_buffer_slice_retain(sb_buffer_slice_t *slice, sb_buffer_slice_t *copy) {
+	if(slice->refs) {
+		++*slice->refs;
+	}
+	*(unsigned *)&copy->size = slice->size;
+	copy->data = slice->data;
+	copy->storage = slice->storage;
+	copy->refs = slice->refs;
+	copy->allocator = slice->allocator;
+}
+
+__songbird_header__
+void sb_buffer_slice_release(sb_buffer_slice_t *slice) {
+	if(slice->refs && --*slice->refs == 0) {
+		__sb_deallocate(slice->allocator, slice->storage);
+		__sb_deallocate(slice->allocator, slice->refs);
+	}
+	*(unsigned *)&slice->size = 0;
+	slice->data = NULL;
+	slice->storage = NULL;
+	slice->refs = NULL;
+}
+
+__songbird_header__
+unsigned char *sb_buffer_slice_mutable(sb_buffer_slice_t *slice) {
+	unsigned char *copy;
+	unsigned *refs;
+	if(slice->refs == NULL || *slice->refs == 1) {
+		return (unsigned char *)slice->data;
+	}
+	/* copy on write, only the bytes this slice can see */
+	copy = (unsigned char *)__sb_allocate(slice->allocator, slice->size ? slice->size : 1);
+	refs = (unsigned *)__sb_allocate(slice->allocator, sizeof(unsigned));
+	if(copy == NULL || refs == NULL) {
+		__sb_deallocate(slice->allocator, copy);
+		__sb_deallocate(slice->allocator, refs);
+		return NULL;
+	}
+	memcpy(copy, slice->data, slice->size);
+	--*slice->refs;
+	*refs = 1;
+	slice->data = copy;
+	slice->storage = copy;
+	slice->refs = refs;
+	return copy;
+}
+
+/* Scanning */
+
+/*
+ * The scanners below return the offset of the first match, or len if there
+ * is no match.
+ */
+
+#ifdef __SB_BUFFER_SSE2__
+#define __sb_ctz(x) ((unsigned)__builtin_ctz(x))
+
+__songbird_header__
+int __sb_buffer_has_avx2(void) {
+	static int has_avx2 = -1;
+	if(has_avx2 < 0) {
+		__builtin_cpu_init();
+		has_avx2 = __builtin_cpu_supports("avx2") != 0;
+	}
+	return has_avx2;
+}
+
+__attribute__((target("avx2")))
+__songbird_header__
+unsigned __sb_scan_byte_avx2(unsigned char const *data, unsigned len, unsigned char value) {
+	__m256i pattern = _mm256_set1_epi8((char)value);
+	unsigned i = 0;
+	for(; i + 32 <= len; i += 32) {
+		__m256i chunk = _mm256_loadu_si256((__m256i const *)(data + i));
+		unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, pattern));
+		if(mask) {
+			return i + __sb_ctz(mask);
+		}
+	}
+	for(; i < len; ++i) {
+		if(data[i] == value) {
+			return i;
+		}
+	}
+	return len;
+}
+
+__songbird_header__
+unsigned __sb_scan_byte(unsigned char const *data, unsigned len, unsigned char value) {
+	__m128i pattern;
+	unsigned i = 0;
+	if(len >= 64 && __sb_buffer_has_avx2()) {
+		return __sb_scan_byte_avx2(data, len, value);
+	}
+	pattern = _mm_set1_epi8((char)value);
+	for(; i + 16 <= len; i += 16) {
+		__m128i chunk = _mm_loadu_si128((__m128i const *)(data + i));
+		unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern));
+		if(mask) {
+			return i + __sb_ctz(mask);
+		}
+	}
+	for(; i < len; ++i) {
+		if(data[i] == value) {
+			return i;
+		}
+	}
+	return len;
+}
+
+__songbird_header__
+unsigned __sb_scan_any(unsigned char const *data, unsigned len, unsigned char const *set, unsigned set_len) {
+	__m128i patterns[16];
+	unsigned i, j;
+	if(set_len > 16) {
+		return len; /* caller uses the table scan */
+	}
+	for(j = 0; j < set_len; ++j) {
+		patterns[j] = _mm_set1_epi8((char)set[j]);
+	}
+	for(i = 0; i + 16 <= len; i += 16) {
+		__m128i chunk = _mm_loadu_si128((__m128i const *)(data + i));
+		__m128i hits = _mm_cmpeq_epi8(chunk, patterns[0]);
+		unsigned mask;
+		for(j = 1; j < set_len; ++j) {
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, patterns[j]));
+		}
+		mask = (unsigned)_mm_movemask_epi8(hits);
+		if(mask) {
+			return i + __sb_ctz(mask);
+		}
+	}
+	for(; i < len; ++i) {
+		for(j = 0; j < set_len; ++j) {
+			if(data[i] == set[j]) {
+				return i;
+			}
+		}
+	}
+	return len;
+}
+
+/*
+ * Compares the first and last byte of the sequence against 16 (or 32)
+ * positions at once and only checks the middle where both match.
+ */
+__attribute__((target("avx2")))
+__songbird_header__
+unsigned __sb_scan_seq_avx2(unsigned char const *data, unsigned len, unsigned char const *seq, unsigned seq_len) {
+	__m256i first = _mm256_set1_epi8((char)seq[0]);
+	__m256i last = _mm256_set1_epi8((char)seq[seq_len - 1]);
+	unsigned i = 0;
+	for(; i + seq_len - 1 + 32 <= len; i += 32) {
+		__m256i head = _mm256_loadu_si256((__m256i const *)(data + i));
+		__m256i tail = _mm256_loadu_si256((__m256i const *)(data + i + seq_len - 1));
+		unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+				_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+		while(mask) {
+			unsigned offset = i + __sb_ctz(mask);
+			if(memcmp(data + offset + 1, seq + 1, seq_len - 2) == 0) {
+				return offset;
+			}
+			mask &= mask - 1;
+		}
+	}
+	for(; i + seq_len <= len; ++i) {
+		if(data[i] == seq[0] && memcmp(data + i, seq, seq_len) == 0) {
+			return i;
+		}
+	}
+	return len;
+}
+
+__songbird_header__
+unsigned __sb_scan_seq(unsigned char const *data, unsigned len, unsigned char const *seq, unsigned seq_len) {
+	__m128i first, last;
+	unsigned i = 0;
+	if(len >= 64 && __sb_buffer_has_avx2()) {
+		return __sb_scan_seq_avx2(data, len, seq, seq_len);
+	}
+	first = _mm_set1_epi8((char)seq[0]);
+	last = _mm_set1_epi8((char)seq[seq_len - 1]);
+	for(; i + seq_len - 1 + 16 <= len; i += 16) {
+		__m128i head = _mm_loadu_si128((__m128i const *)(data + i));
+		__m128i tail = _mm_loadu_si128((__m128i const *)(data + i + seq_len - 1));
+		unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+		while(mask) {
+			unsigned offset = i + __sb_ctz(mask);
+			if(memcmp(data + offset + 1, seq + 1, seq_len - 2) == 0) {
+				return offset;
+			}
+			mask &= mask - 1;
+		}
+	}
+	for(; i + seq_len <= len; ++i) {
+		if(data[i] == seq[0] && memcmp(data + i, seq, seq_len) == 0) {
+			return i;
+		}
+	}
+	return len;
+}
+
+#else /* __SB_BUFFER_SSE2__ */
+
+/* word at a time, a byte is zero if its high bit survives (x - 1) & ~x */
+#define __SB_SWAR_ONES (~(uint64_t)0 / 255)
+#define __SB_SWAR_HIGHS (__SB_SWAR_ONES * 0x80)
+
+__songbird_header__
+unsigned __sb_scan_byte(unsigned char const *data, unsigned len, unsigned char value) {
+	uint64_t pattern = __SB_SWAR_ONES * value;
+	unsigned i = 0;
+	for(; i + 8 <= len; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		word ^= pattern;
+		if((word - __SB_SWAR_ONES) & ~word & __SB_SWAR_HIGHS) {
+			break; /* the match is somewhere in these 8 bytes */
+		}
+	}
+	for(; i < len; ++i) {
+		if(data[i] == value) {
+			return i;
+		}
+	}
+	return len;
+}
+
+__songbird_header__
+unsigned __sb_scan_seq(unsigned char const *data, unsigned len, unsigned char const *seq, unsigned seq_len) {
+	unsigned i = 0;
+	while(i + seq_len <= len) {
+		i += __sb_scan_byte(data + i, len - seq_len + 1 - i, seq[0]);
+		if(i + seq_len > len) {
+			break;
+		}
+		if(memcmp(data + i, seq, seq_len) == 0) {
+			return i;
+		}
+		++i;
+	}
+	return len;
+}
+
+#endif /* __SB_BUFFER_SSE2__ */
+
+__songbird_header__
+int sb_buffer_find_byte(sb_buffer_t *buffer, int value) {
+	unsigned len, offset;
+	unsigned char const *data = sb_buffer_peek(buffer, &len);
+	offset = __sb_scan_byte(data, len, (unsigned char)value);
+	return offset == len ? -1 : (int)(buffer->index + offset);
+}
+
+__songbird_header__
+int sb_buffer_find_any(sb_buffer_t *buffer, void const *set, unsigned set_len) {
+	unsigned char const *bytes = (unsigned char const *)set;
+	unsigned char table[256];
+	unsigned len, i;
+	unsigned char const *data = sb_buffer_peek(buffer, &len);
+	if(set_len == 0 || len == 0) {
+		return -1;
+	}
+	if(set_len == 1) {
+		return sb_buffer_find_byte(buffer, bytes[0]);
+	}
+#ifdef __SB_BUFFER_SSE2__
+	if(set_len <= 16) {
+		i = __sb_scan_any(data, len, bytes, set_len);
+		return i == len ? -1 : (int)(buffer->index + i);
+	}
+#endif
+	memset(table, 0, sizeof(table));
+	for(i = 0; i < set_len; ++i) {
+		table[bytes[i]] = 1;
+	}
+	for(i = 0; i < len; ++i) {
+		if(table[data[i]]) {
+			return (int)(buffer->index + i);
+		}
+	}
+	return -1;
+}
+
+__songbird_header__
+int sb_buffer_find_seq(sb_buffer_t *buffer, void const *seq, unsigned seq_len) {
+	unsigned len, offset;
+	unsigned char const *data = sb_buffer_peek(buffer, &len);
+	if(seq_len == 0) {
+		return (int)buffer->index;
+	}
+	if(seq_len > len) {
+		return -1;
+	}
+	if(seq_len == 1) {
+		offset = __sb_scan_byte(data, len, *(unsigned char const *)seq);
+	} else {
+		offset = __sb_scan_seq(data, len, (unsigned char const *)seq, seq_len);
+	}
+	return offset == len ? -1 : (int)(buffer->index + offset);
+}
+
+/* Typed encoding */
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define __SB_BUFFER_BIG_ENDIAN__
+#endif
+#elif defined(__BIG_ENDIAN__) || defined(_BIG_ENDIAN)
+#define __SB_BUFFER_BIG_ENDIAN__
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define __sb_bswap16(x) __builtin_bswap16(x)
+#define __sb_bswap32(x) __builtin_bswap32(x)
+#define __sb_bswap64(x) __builtin_bswap64(x)
+#elif defined(_MSC_VER)
+#define __sb_bswap16(x) _byteswap_ushort(x)
+#define __sb_bswap32(x) _byteswap_ulong(x)
+#define __sb_bswap64(x) _byteswap_uint64(x)
+#else
+#define __sb_bswap16(x) ((uint16_t)(((x) >> 8) | ((x) << 8)))
+#define __sb_bswap32(x) ((uint32_t)( \
+	(((x) & 0xff000000UL) >> 24) | (((x) & 0x00ff0000UL) >> 8) | \
+	(((x) & 0x0000ff00UL) << 8) | (((x) & 0x000000ffUL) << 24)))
+#define __sb_bswap64(x) ((uint64_t)( \
+	((uint64_t)__sb_bswap32((uint32_t)(x)) << 32) | \
+	__sb_bswap32((uint32_t)((x) >> 32))))
+#endif
+
+/* convert between host order and little (le) or big (be) endian */
+#ifdef __SB_BUFFER_BIG_ENDIAN__
+#define __sb_le16(x) __sb_bswap16(x)
+#define __sb_le32(x) __sb_bswap32(x)
+#define __sb_le64(x) __sb_bswap64(x)
+#define __sb_be16(x) (x)
+#define __sb_be32(x) (x)
+#define __sb_be64(x) (x)
+#else
+#define __sb_le16(x) (x)
+#define __sb_le32(x) (x)
+#define __sb_le64(x) (x)
+#define __sb_be16(x) __sb_bswap16(x)
+#define __sb_be32(x) __sb_bswap32(x)
+#define __sb_be64(x) __sb_bswap64(x)
+#endif
+
+/**
+ * Adds a fixed size value to the end of the buffer. With a constant length
+ * the memcpy becomes a single unaligned store.
+ */
+__songbird_header__
+int __sb_buffer_put_raw(sb_buffer_t *buffer, void const *ptr, unsigned len) {
+	if(buffer->capacity - buffer->size < len) {
+		if(sb_buffer_reserve(buffer, len)) {
+			return SB_BUFFER_ERROR;
+		}
+	}
+	memcpy((unsigned char *)buffer->data + buffer->size, ptr, len);
+	*(unsigned *)&buffer->size += len;
+	return SB_BUFFER_OK;
+}
+
+/**
+ * Reads a fixed size value from the read index. Nothing is consumed unless
+ * the whole value is available.
+ */
+__songbird_header__
+int __sb_buffer_get_raw(sb_buffer_t *buffer, void *out, unsigned len) {
+	if(buffer->index >= buffer->size || buffer->size - buffer->index < len) {
+		return SB_BUFFER_SHORT;
+	}
+	memcpy(out, buffer->data + buffer->index, len);
+	*(unsigned *)&buffer->index += len;
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_put_u8(sb_buffer_t *buffer, uint8_t value) {
+	return __sb_buffer_put_raw(buffer, &value, 1);
+}
+
+__songbird_header__
+int sb_buffer_put_u16le(sb_buffer_t *buffer, uint16_t value) {
+	value = __sb_le16(value);
+	return __sb_buffer_put_raw(buffer, &value, 2);
+}
+
+__songbird_header__
+int sb_buffer_put_u16be(sb_buffer_t *buffer, uint16_t value) {
+	value = __sb_be16(value);
+	return __sb_buffer_put_raw(buffer, &value, 2);
+}
+
+__songbird_header__
+int sb_buffer_put_u32le(sb_buffer_t *buffer, uint32_t value) {
+	value = __sb_le32(value);
+	return __sb_buffer_put_raw(buffer, &value, 4);
+}
+
+__songbird_header__
+int sb_buffer_put_u32be(sb_buffer_t *buffer, uint32_t value) {
+	value = __sb_be32(value);
+	return __sb_buffer_put_raw(buffer, &value, 4);
+}
+
+__songbird_header__
+int sb_buffer_put_u64le(sb_buffer_t *buffer, uint64_t value) {
+	value = __sb_le64(value);
+	return __sb_buffer_put_raw(buffer, &value, 8);
+}
+
+__songbird_header__
+int sb_buffer_put_u64be(sb_buffer_t *buffer, uint64_t value) {
+	value = __sb_be64(value);
+	return __sb_buffer_put_raw(buffer, &value, 8);
+}
+
+__songbird_header__
+int sb_buffer_put_f32le(sb_buffer_t *buffer, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+	return sb_buffer_put_u32le(buffer, bits);
+}
+
+__songbird_header__
+int sb_buffer_put_f32be(sb_buffer_t *buffer, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+	return sb_buffer_put_u32be(buffer, bits);
+}
+
+__songbird_header__
+int sb_buffer_put_f64le(sb_buffer_t *buffer, double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, 8);
+	return sb_buffer_put_u64le(buffer, bits);
+}
+
+__songbird_header__
+int sb_buffer_put_f64be(sb_buffer_t *buffer, double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, 8);
+	return sb_buffer_put_u64be(buffer, bits);
+}
+
+__songbird_header__
+int sb_buffer_put_varint(sb_buffer_t *buffer, uint64_t value) {
+	unsigned char *out;
+	unsigned len = 0;
+	/* reserve the worst case once and encode straight into the buffer */
+	if(buffer->capacity - buffer->size < 10) {
+		if(sb_buffer_reserve(buffer, 10)) {
+			return SB_BUFFER_ERROR;
+		}
+	}
+	out = (unsigned char *)buffer->data + buffer->size;
+	while(value >= 0x80) {
+		out[len++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	out[len++] = (unsigned char)value;
+	*(unsigned *)&buffer->size += len;
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_put_svarint(sb_buffer_t *buffer, int64_t value) {
+	uint64_t zigzag = ((uint64_t)value << 1) ^ (0 - ((uint64_t)value >> 63));
+	return sb_buffer_put_varint(buffer, zigzag);
+}
+
+__songbird_header__
+int sb_buffer_put_bytes(sb_buffer_t *buffer, void const *ptr, unsigned len) {
+	if(sb_buffer_put_varint(buffer, len)) {
+		return SB_BUFFER_ERROR;
+	}
+	return __sb_buffer_put_raw(buffer, ptr, len);
+}
+
+__songbird_header__
+int sb_buffer_get_u8(sb_buffer_t *buffer, uint8_t *value) {
+	return __sb_buffer_get_raw(buffer, value, 1);
+}
+
+__songbird_header__
+int sb_buffer_get_u16le(sb_buffer_t *buffer, uint16_t *value) {
+	uint16_t raw;
+	if(__sb_buffer_get_raw(buffer, &raw, 2)) {
+		return SB_BUFFER_SHORT;
+	}
+	*value = __sb_le16(raw);
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_get_u16be(sb_buffer_t *buffer, uint16_t *value) {
+	uint16_t raw;
+	if(__sb_buffer_get_raw(buffer, &raw, 2)) {
+		return SB_BUFFER_SHORT;
+	}
+	*value = __sb_be16(raw);
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_get_u32le(sb_buffer_t *buffer, uint32_t *value) {
+	uint32_t raw;
+	if(__sb_buffer_get_raw(buffer, &raw, 4)) {
+		return SB_BUFFER_SHORT;
+	}
+	*value = __sb_le32(raw);
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_get_u32be(sb_buffer_t *buffer, uint32_t *value) {
+	uint32_t raw;
+	if(__sb_buffer_get_raw(buffer, &raw, 4)) {
+		return SB_BUFFER_SHORT;
+	}
+	*value = __sb_be32(raw);
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_get_u64le(sb_buffer_t *buffer, uint64_t *value) {
+	uint64_t raw;
+	if(__sb_buffer_get_raw(buffer, &raw, 8)) {
+		return SB_BUFFER_SHORT;
+	}
+	*value = __sb_le64(raw);
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_get_u64be(sb_buffer_t *buffer, uint64_t *value) {
+	uint64_t raw;
+	if(__sb_buffer_get_raw(buffer, &raw, 8)) {
+		return SB_BUFFER_SHORT;
+	}
+	*value = __sb_be64(raw);
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_get_f32le(sb_buffer_t *buffer, float *value) {
+	uint32_t bits;
+	if(sb_buffer_get_u32le(buffer, &bits)) {
+		return SB_BUFFER_SHORT;
+	}
+	memcpy(value, &bits, 4);
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_get_f32be(sb_buffer_t *buffer, float *value) {
+	uint32_t bits;
+	if(sb_buffer_get_u32be(buffer, &bits)) {
+		return SB_BUFFER_SHORT;
+	}
+	memcpy(value, &bits, 4);
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_get_f64le(sb_buffer_t *buffer, double *value) {
+	uint64_t bits;
+	if(sb_buffer_get_u64le(buffer, &bits)) {
+		return SB_BUFFER_SHORT;
+	}
+	memcpy(value, &bits, 8);
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_get_f64be(sb_buffer_t *buffer, double *value) {
+	uint64_t bits;
+	if(sb_buffer_get_u64be(buffer, &bits)) {
+		return SB_BUFFER_SHORT;
+	}
+	memcpy(value, &bits, 8);
+	return SB_BUFFER_OK;
+}
+
+__songbird_header__
+int sb_buffer_get_varint(sb_buffer_t *buffer, uint64_t *value) {
+	unsigned char const *in;
+	unsigned available, i;
+	uint64_t result = 0;
+	if(buffer->index >= buffer->size) {
+		return SB_BUFFER_SHORT;
+	}
+	in = buffer->data + buffer->index;
+	available = buffer->size - buffer->index;
+	for(i = 0; i < available; ++i) {
+		/* the tenth byte only holds the top bit and has to be the last */
+		if(i == 9 && in[i] > 1) {
+			return SB_BUFFER_OVERFLOW;
+		}
+		result |= (uint64_t)(in[i] & 0x7f) << (7 * i);
+		if((in[i] & 0x80) == 0) {
+			*value = result;
+			*(unsigned *)&buffer->index += i + 1;
+			return SB_BUFFER_OK;
+		}
+	}
+	return SB_BUFFER_SHORT;
+}
+
+__songbird_header__
+int sb_buffer_get_svarint(sb_buffer_t *buffer, int64_t *value) {
+	uint64_t zigzag;
+	int result = sb_buffer_get_varint(buffer, &zigzag);
+	if(result == SB_BUFFER_OK) {
+		*value = (int64_t)((zigzag >> 1) ^ (0 - (zigzag & 1)));
+	}
+	return result;
+}
+
+__songbird_header__
+int sb_buffer_get_bytes(sb_buffer_t *buffer, unsigned char const **ptr, unsigned *len) {
+	unsigned start = buffer->index;
+	uint64_t length;
+	int result = sb_buffer_get_varint(buffer, &length);
+	if(result != SB_BUFFER_OK) {
+		return result;
+	}
+	if(buffer->size - buffer->index < length) {
+		/* put the length back so the whole value can be read later */
+		*(unsigned *)&buffer->index = start;
+		return SB_BUFFER_SHORT;
+	}
+	*ptr = buffer->data + buffer->index;
+	*len = (unsigned)length;
+	*(unsigned *)&buffer->index += *len;
+	return SB_BUFFER_OK;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,6 +30,29 @@
 #define sb_free free
 #endif /* __SB_NO_ALLOC__ */
 
+#ifndef __SB_ALLOCATOR__
+#define __SB_ALLOCATOR__
+#include <stddef.h>
+/*
+ * A runtime allocator, handed to a container when it is initialized. A NULL
+ * allocator stands for sb_malloc, sb_realloc and sb_free. The allocator has
+ * to outlive every container using it and release has to accept NULL.
+ * alloc.h provides arena and pool allocators.
+ */
+typedef struct sb_allocator {
+	void *(*alloc)(void *context, size_t size);
+	void *(*resize)(void *context, void *ptr, size_t size);
+	void (*release)(void *context, void *ptr);
+	void *context;
+} sb_allocator_t;
+#define __sb_allocate(a, size) \
+	((a) ? (a)->alloc((a)->context, (size)) : sb_malloc(size))
+#define __sb_reallocate(a, ptr, size) \
+	((a) ? (a)->resize((a)->context, (ptr), (size)) : sb_realloc((ptr), (size)))
+#define __sb_deallocate(a, ptr) \
+	((a) ? (a)->release((a)->context, (ptr)) : sb_free(ptr))
+#endif
+
 #ifdef __cplusplus
 /* Not sure why you would want to use this in C++, but just in case. */
 extern "C" {
@@ -62,6 +85,14 @@ int sb_error = SB_ERROR_NONE;
 typedef void (*sb_iter_f)(void const *);
 #endif
 
+#ifndef __songbird_each_func__
+#define __songbird_each_func__
+/** gets the context, a value and its index, non-zero stops the iteration */
+typedef int (*sb_each_f)(void *context, void const *value, unsigned index);
+/** gets count consecutive entries, the first at index, non-zero stops */
+typedef int (*sb_span_f)(void *context, void const **entries, unsigned count, unsigned index);
+#endif
+
 /* 
  * This is an implementation of a double ended array backed queue.
  * Suitable for both FIFO and LIFO.
@@ -82,6 +113,7 @@ typedef struct sb_deque {
 	unsigned const back;
 	unsigned const capacity;
 	void const **entries;
+	sb_allocator_t const *allocator;
 } sb_deque_t;
 
 /**
@@ -97,10 +129,22 @@ void sb_deque_init(sb_deque_t *deque);
  * is set to SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
  * @param deque The deque to initialize.
  * @param capacity The initial capacity of the deque, if 0 it defaults to 16
- * 		(the SB_DEQUE_DEFAULT_CAPACITY).
+ * 		(the SB_DEQUE_DEFAULT_CAPACITY). It is rounded up to a power of two.
  */
 __songbird_header__
-void sb_deque_init(sb_deque_t *deque, unsigned capacity);
+void sb_deque_init_cap(sb_deque_t *deque, unsigned capacity);
+
+/**
+ * Initializes the specified deque with the given initial capacity, taking
+ * its memory from the given allocator. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
+ * @param deque The deque to initialize.
+ * @param capacity The initial capacity of the deque, as for sb_deque_init_cap.
+ * @param allocator The allocator, or NULL for sb_malloc.
+ */
+__songbird_header__
+void sb_deque_init_alloc(sb_deque_t *deque, unsigned capacity,
+	sb_allocator_t const *allocator);
 
 /**
  * Frees all allocated memory for the given deque.
@@ -174,19 +218,57 @@ void const *sb_deque_pop_back(sb_deque_t *deque);
 __songbird_header__
 void sb_deque_iterate(sb_deque_t *deque, sb_iter_f iter);
 
+/**
+ * Iterates through the given deque calling the specified function with the
+ * context, every value and its index, until it returns non-zero.
+ * @param deque The deque.
+ * @param each The function to call, it must not be NULL.
+ * @param context Passed to each.
+ * @return The index at which each returned non-zero, or the size of the
+ * 		deque if it never did.
+ */
+__songbird_header__
+unsigned sb_deque_each(sb_deque_t *deque, sb_each_f each, void *context);
+
+/**
+ * Hands the entries of the given deque to the specified function as
+ * contiguous spans, so the function can loop over them itself. When the
+ * ring wraps around the entries come in two spans, the index of the second
+ * one follows on from the first. An empty deque has none.
+ * @param deque The deque.
+ * @param span The function to call, it must not be NULL.
+ * @param context Passed to span.
+ * @return What span returned if it was non-zero, otherwise 0.
+ */
+__songbird_header__
+int sb_deque_each_span(sb_deque_t *deque, sb_span_f span, void *context);
+
 /* function definitions */
 
 __songbird_header__
 void sb_deque_init(sb_deque_t *deque) {
-	sb_deque_init(deque, SB_DEQUE_DEFAULT_CAPACITY);
+	sb_deque_init_alloc(deque, SB_DEQUE_DEFAULT_CAPACITY, NULL);
+}
+
+__songbird_header__
+void sb_deque_init_cap(sb_deque_t *deque, unsigned capacity) {
+	sb_deque_init_alloc(deque, capacity, NULL);
 }
 
 __songbird_header__
-void sb_deque_init(sb_deque_t *deque, unsigned capacity) {
+void sb_deque_init_alloc(sb_deque_t *deque, unsigned capacity,
+		sb_allocator_t const *allocator) {
+	/* the indices wrap with a mask, so the capacity is a power of two */
+	unsigned n = SB_DEQUE_DEFAULT_CAPACITY;
+	if(capacity != 0) {
+		for(n = 2; n < capacity && n * 2 > n; n *= 2);
+	}
 	*(unsigned *)&deque->front = 0;
 	*(unsigned *)&deque->back = 0;
-	*(unsigned *)&deque->capacity = capacity;
-	deque->entries = (const void **)sb_malloc(sizeof(void *) * deque->capacity);
+	*(unsigned *)&deque->capacity = n;
+	deque->allocator = allocator;
+	deque->entries = (const void **)__sb_allocate(allocator,
+			sizeof(void *) * deque->capacity);
 	if(deque->entries == NULL) {
 		sb_error = SB_ERROR_MEMORY_ALLOCATION;
 	}
@@ -198,7 +280,7 @@ void sb_deque_free(sb_deque_t *deque) {
 		return;
 	}
 	if(deque->entries) {
-		sb_free(deque->entries);
+		__sb_deallocate(deque->allocator, (void *)deque->entries);
 	}
 }
 
@@ -214,7 +296,8 @@ void __sb_deque_resize(sb_deque_t *deque) {
 	unsigned r = n - deque->front;
 	unsigned new_capacity = n * 2;
 	/* if new_capacity < deque->capacity we have a problem */
-	const void **new_entries = sb_malloc(sizeof(void *) * new_capacity);
+	const void **new_entries = (const void **)__sb_allocate(deque->allocator,
+			sizeof(void *) * new_capacity);
 	if(new_entries == NULL) {
 		sb_error = SB_ERROR_MEMORY_ALLOCATION;
 		return; /* FAILURE! */
@@ -226,7 +309,7 @@ void __sb_deque_resize(sb_deque_t *deque) {
 	for(i = 0; i < deque->back; ++i) {
 		new_entries[r + i] = deque->entries[i];
 	}
-	sb_free(deque->entries);
+	__sb_deallocate(deque->allocator, (void *)deque->entries);
 	deque->entries = new_entries;
 	*(unsigned *)&deque->capacity = new_capacity;
 	*(unsigned *)&deque->front = 0;
@@ -298,6 +381,40 @@ void sb_deque_iterate(sb_deque_t *queue, sb_iter_f iterfun) {
 	}
 }
 
+__songbird_header__
+unsigned sb_deque_each(sb_deque_t *deque, sb_each_f each, void *context) {
+	unsigned cursor = deque->front;
+	unsigned i = 0;
+	while(cursor != deque->back) {
+		if(each(context, deque->entries[cursor], i)) {
+			break;
+		}
+		cursor = (cursor + 1) & (deque->capacity - 1);
+		++i;
+	}
+	return i;
+}
+
+__songbird_header__
+int sb_deque_each_span(sb_deque_t *deque, sb_span_f span, void *context) {
+	unsigned first;
+	int result;
+	if(deque->front == deque->back) {
+		return 0;
+	}
+	if(deque->front < deque->back) {
+		return span(context, deque->entries + deque->front,
+				deque->back - deque->front, 0);
+	}
+	/* wrapped, from the front to the end of the ring and then from its start */
+	first = deque->capacity - deque->front;
+	result = span(context, deque->entries + deque->front, first, 0);
+	if(result || deque->back == 0) {
+		return result;
+	}
+	return span(context, deque->entries, deque->back, first);
+}
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,687 @@
+/**
+ * Copyright (c) 2014-2017 Robert Maupin <chasesan@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __SONGBIRD_EVENTS_H__
+#define __SONGBIRD_EVENTS_H__
+
+/*
+ * An event loop for sockets (or any other file descriptor). Uses edge
+ * triggered epoll on Linux and poll everywhere else, define
+ * SB_EVENTS_USE_POLL to use poll on Linux as well. Under poll readiness is
+ * level triggered, but callbacks written for edge triggering (read or write
+ * until SB_SOCK_NONE) work the same under both.
+ */
+
+/*
+ * Strict C modes hide the POSIX and BSD functions used below. This asks for
+ * them, but only works if no system header was included before this file,
+ * otherwise compile with _DEFAULT_SOURCE defined.
+ */
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE) && !defined(_GNU_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#if defined(__linux__) && !defined(SB_EVENTS_USE_POLL)
+#define __SB_EVENTS_EPOLL__
+#include <sys/epoll.h>
+#endif
+#endif
+
+#ifndef __SB_NO_ALLOC__
+#include <stdlib.h>
+#define sb_malloc malloc
+#define sb_realloc realloc
+#define sb_free free
+#endif /* __SB_NO_ALLOC__ */
+
+#ifdef __cplusplus
+/* Not sure why you would want to use this in C++, but just in case. */
+extern "C" {
+#define __songbird_header__	inline
+/* Works even if __STDC_VERSION__ is not defined. */
+#elif __STDC_VERSION__ <= 199409L
+#define __songbird_header__	static __inline__
+#else
+#define __songbird_header__	static inline
+#endif
+
+#ifdef _WIN32
+#define poll	WSAPoll
+#endif
+
+enum {
+	SB_EVENT_READ = 1,
+	SB_EVENT_WRITE = 2,
+	SB_EVENT_ERROR = 4,
+	SB_EVENT_HANGUP = 8
+};
+
+enum {
+	/* milliseconds per timer wheel tick */
+	SB_EVENTS_TICK = 10,
+	/* slots in the timer wheel, must be a power of two */
+	SB_EVENTS_WHEEL_SIZE = 256,
+	/* most events handled per wait */
+	SB_EVENTS_BATCH = 64
+};
+
+typedef struct sb_events sb_events_t;
+
+/** called with the descriptor, the SB_EVENT_* flags that are ready and the registered data */
+typedef void (*sb_event_f)(sb_events_t *, int, unsigned, void *);
+
+/** called when a timer expires with the registered data */
+typedef void (*sb_timer_f)(sb_events_t *, void *);
+
+/**
+ * @brief A timer.
+ * Timers are owned by the caller and must stay valid while they are
+ * scheduled. A timer has to be initialized with sb_events_timer_init once,
+ * before it is first added or cancelled. It is highly recommended you do not change any values in this
+ * structure manually.
+ */
+typedef struct sb_events_timer {
+	struct sb_events_timer *next;
+	struct sb_events_timer *prev;
+	unsigned rounds;
+	sb_timer_f callback;
+	void *data;
+} sb_events_timer_t;
+
+struct __sb_event_slot {
+	sb_event_f callback;
+	void *data;
+	unsigned interest;
+	int active;
+};
+
+/**
+ * @brief The event loop structure.
+ * This is the structure used by the sb_events_* functions.
+ * It is highly recommended you do not change any values in this
+ * structure manually.
+ */
+struct sb_events {
+#ifdef __SB_EVENTS_EPOLL__
+	int epoll;
+#else
+	struct pollfd *polls;
+	unsigned poll_count;
+	/* position of each descriptor in polls */
+	unsigned *poll_index;
+#endif
+	/* registrations indexed by descriptor */
+	struct __sb_event_slot *slots;
+	unsigned slot_count;
+	sb_events_timer_t wheel[SB_EVENTS_WHEEL_SIZE];
+	unsigned tick;
+	unsigned long last_tick;
+	unsigned timers;
+	int running;
+};
+
+/**
+ * Initializes the specified event loop.
+ * @param events The event loop to initialize.
+ * @return 0 on success, -1 on failure.
+ */
+__songbird_header__
+int sb_events_init(sb_events_t *events);
+
+/**
+ * Frees all allocated resources for the given event loop. Registered
+ * descriptors are not closed.
+ * @param events The event loop to free.
+ */
+__songbird_header__
+void sb_events_free(sb_events_t *events);
+
+/**
+ * Registers a descriptor, which should be non blocking.
+ * @param events The event loop.
+ * @param fd The descriptor.
+ * @param interest SB_EVENT_READ and/or SB_EVENT_WRITE.
+ * @param callback The function called when the descriptor is ready.
+ * @param data Passed to the callback.
+ * @return 0 on success, -1 on failure.
+ */
+__songbird_header__
+int sb_events_add(sb_events_t *events, int fd, unsigned interest,
+		sb_event_f callback, void *data);
+
+/**
+ * Changes what a registered descriptor is waiting for.
+ * @param events The event loop.
+ * @param fd The descriptor.
+ * @param interest SB_EVENT_READ and/or SB_EVENT_WRITE.
+ * @return 0 on success, -1 on failure.
+ */
+__songbird_header__
+int sb_events_modify(sb_events_t *events, int fd, unsigned interest);
+
+/**
+ * Unregisters a descriptor. This must be done before closing it. It is safe
+ * to call this from inside a callback.
+ * @param events The event loop.
+ * @param fd The descriptor.
+ */
+__songbird_header__
+void sb_events_remove(sb_events_t *events, int fd);
+
+/**
+ * Initializes a timer as not scheduled.
+ * @param timer The timer.
+ */
+__songbird_header__
+void sb_events_timer_init(sb_events_timer_t *timer);
+
+/**
+ * Schedules a timer. A timer may be scheduled again from its own callback.
+ * @param events The event loop.
+ * @param timer The timer, must not already be scheduled.
+ * @param timeout Milliseconds until the timer expires, rounded up to the
+ * 		next SB_EVENTS_TICK. The timer never expires early, but may
+ * 		expire up to a tick late.
+ * @param callback The function called when the timer expires.
+ * @param data Passed to the callback.
+ */
+__songbird_header__
+void sb_events_timer_add(sb_events_t *events, sb_events_timer_t *timer,
+		unsigned timeout, sb_timer_f callback, void *data);
+
+/**
+ * Cancels a timer. Does nothing if the timer is not scheduled.
+ * @param events The event loop.
+ * @param timer The timer.
+ */
+__songbird_header__
+void sb_events_timer_cancel(sb_events_t *events, sb_events_timer_t *timer);
+
+/**
+ * Waits for events and dispatches them, then runs expired timers.
+ * @param events The event loop.
+ * @param timeout The most milliseconds to wait, -1 to wait until something
+ * 		happens.
+ * @return The number of descriptor events dispatched, -1 on failure.
+ */
+__songbird_header__
+int sb_events_poll(sb_events_t *events, int timeout);
+
+/**
+ * Dispatches events until sb_events_stop is called.
+ * @param events The event loop.
+ * @return 0 when stopped, -1 on failure.
+ */
+__songbird_header__
+int sb_events_run(sb_events_t *events);
+
+/**
+ * Makes sb_events_run return after the current round.
+ * @param events The event loop.
+ */
+__songbird_header__
+void sb_events_stop(sb_events_t *events);
+
+/* function definitions */
+
+__songbird_header__
+unsigned long __sb_events_now() {
+#ifdef _WIN32
+	return (unsigned long)GetTickCount64();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+}
+
+__songbird_header__
+int sb_events_init(sb_events_t *events) {
+	unsigned i;
+	memset(events, 0, sizeof(sb_events_t));
+#ifdef __SB_EVENTS_EPOLL__
+	events->epoll = epoll_create1(EPOLL_CLOEXEC);
+	if(events->epoll < 0) {
+		return -1;
+	}
+#endif
+	for(i = 0; i < SB_EVENTS_WHEEL_SIZE; ++i) {
+		events->wheel[i].next = &events->wheel[i];
+		events->wheel[i].prev = &events->wheel[i];
+	}
+	events->last_tick = __sb_events_now();
+	return 0;
+}
+
+__songbird_header__
+void sb_events_free(sb_events_t *events) {
+#ifdef __SB_EVENTS_EPOLL__
+	if(events->epoll >= 0) {
+		close(events->epoll);
+	}
+	events->epoll = -1;
+#else
+	sb_free(events->polls);
+	sb_free(events->poll_index);
+	events->polls = NULL;
+	events->poll_index = NULL;
+#endif
+	sb_free(events->slots);
+	events->slots = NULL;
+	events->slot_count = 0;
+}
+
+/**
+ * Makes sure there is a slot for the given descriptor.
+ * This function is not designed to be called by the end user.
+ */
+__songbird_header__
+int __sb_events_reserve(sb_events_t *events, int fd) {
+	unsigned count = events->slot_count ? events->slot_count : 64;
+	struct __sb_event_slot *slots;
+	if(fd < 0) {
+		return -1;
+	}
+	if((unsigned)fd < events->slot_count) {
+		return 0;
+	}
+	while(count <= (unsigned)fd) {
+		count *= 2;
+	}
+	slots = (struct __sb_event_slot *)sb_realloc(events->slots,
+			sizeof(struct __sb_event_slot) * count);
+	if(slots == NULL) {
+		return -1;
+	}
+	memset(slots + events->slot_count, 0,
+			sizeof(struct __sb_event_slot) * (count - events->slot_count));
+	events->slots = slots;
+#ifndef __SB_EVENTS_EPOLL__
+	{
+		unsigned *poll_index = (unsigned *)sb_realloc(events->poll_index,
+				sizeof(unsigned) * count);
+		struct pollfd *polls = (struct pollfd *)sb_realloc(events->polls,
+				sizeof(struct pollfd) * count);
+		if(poll_index) {
+			events->poll_index = poll_index;
+		}
+		if(polls) {
+			events->polls = polls;
+		}
+		if(poll_index == NULL || polls == NULL) {
+			return -1;
+		}
+	}
+#endif
+	events->slot_count = count;
+	return 0;
+}
+
+#ifdef __SB_EVENTS_EPOLL__
+__songbird_header__
+unsigned __sb_events_to_epoll(unsigned interest) {
+	unsigned flags = EPOLLET | EPOLLRDHUP;
+	if(interest & SB_EVENT_READ) {
+		flags |= EPOLLIN;
+	}
+	if(interest & SB_EVENT_WRITE) {
+		flags |= EPOLLOUT;
+	}
+	return flags;
+}
+#else
+__songbird_header__
+short __sb_events_to_poll(unsigned interest) {
+	short flags = 0;
+	if(interest & SB_EVENT_READ) {
+		flags |= POLLIN;
+	}
+	if(interest & SB_EVENT_WRITE) {
+		flags |= POLLOUT;
+	}
+	return flags;
+}
+#endif
+
+__songbird_header__
+int sb_events_add(sb_events_t *events, int fd, unsigned interest,
+		sb_event_f callback, void *data) {
+	struct __sb_event_slot *slot;
+#ifdef __SB_EVENTS_EPOLL__
+	struct epoll_event event;
+#endif
+	if(__sb_events_reserve(events, fd)) {
+		return -1;
+	}
+	slot = &events->slots[fd];
+	if(slot->active) {
+		return -1;
+	}
+#ifdef __SB_EVENTS_EPOLL__
+	memset(&event, 0, sizeof(event));
+	event.events = __sb_events_to_epoll(interest);
+	event.data.fd = fd;
+	if(epoll_ctl(events->epoll, EPOLL_CTL_ADD, fd, &event)) {
+		return -1;
+	}
+#else
+	events->poll_index[fd] = events->poll_count;
+	events->polls[events->poll_count].fd = fd;
+	events->polls[events->poll_count].events = __sb_events_to_poll(interest);
+	events->polls[events->poll_count].revents = 0;
+	++events->poll_count;
+#endif
+	slot->callback = callback;
+	slot->data = data;
+	slot->interest = interest;
+	slot->active = 1;
+	return 0;
+}
+
+__songbird_header__
+int sb_events_modify(sb_events_t *events, int fd, unsigned interest) {
+#ifdef __SB_EVENTS_EPOLL__
+	struct epoll_event event;
+#endif
+	if(fd < 0 || (unsigned)fd >= events->slot_count || !events->slots[fd].active) {
+		return -1;
+	}
+#ifdef __SB_EVENTS_EPOLL__
+	memset(&event, 0, sizeof(event));
+	event.events = __sb_events_to_epoll(interest);
+	event.data.fd = fd;
+	if(epoll_ctl(events->epoll, EPOLL_CTL_MOD, fd, &event)) {
+		return -1;
+	}
+#else
+	events->polls[events->poll_index[fd]].events = __sb_events_to_poll(interest);
+#endif
+	events->slots[fd].interest = interest;
+	return 0;
+}
+
+__songbird_header__
+void sb_events_remove(sb_events_t *events, int fd) {
+#ifdef __SB_EVENTS_EPOLL__
+	struct epoll_event event;
+#else
+	unsigned index;
+	unsigned last;
+#endif
+	if(fd < 0 || (unsigned)fd >= events->slot_count || !events->slots[fd].active) {
+		return;
+	}
+#ifdef __SB_EVENTS_EPOLL__
+	/* old kernels want a non NULL event even for delete */
+	memset(&event, 0, sizeof(event));
+	epoll_ctl(events->epoll, EPOLL_CTL_DEL, fd, &event);
+#else
+	/* move the last entry into the hole */
+	index = events->poll_index[fd];
+	last = --events->poll_count;
+	if(index != last) {
+		events->polls[index] = events->polls[last];
+		events->poll_index[events->polls[index].fd] = index;
+	}
+#endif
+	events->slots[fd].active = 0;
+	events->slots[fd].callback = NULL;
+	events->slots[fd].data = NULL;
+}
+
+__songbird_header__
+void __sb_events_timer_unlink(sb_events_timer_t *timer) {
+	timer->prev->next = timer->next;
+	timer->next->prev = timer->prev;
+	timer->next = NULL;
+	timer->prev = NULL;
+}
+
+__songbird_header__
+void __sb_events_timer_link(sb_events_timer_t *head, sb_events_timer_t *timer) {
+	timer->prev = head->prev;
+	timer->next = head;
+	head->prev->next = timer;
+	head->prev = timer;
+}
+
+__songbird_header__
+void sb_events_timer_init(sb_events_timer_t *timer) {
+	memset(timer, 0, sizeof(sb_events_timer_t));
+}
+
+__songbird_header__
+void sb_events_timer_add(sb_events_t *events, sb_events_timer_t *timer,
+		unsigned timeout, sb_timer_f callback, void *data) {
+	unsigned ticks = (timeout + SB_EVENTS_TICK - 1) / SB_EVENTS_TICK;
+	unsigned long elapsed;
+	if(ticks == 0) {
+		ticks = 1;
+	}
+	if(events->timers == 0) {
+		/* the wheel was idle, start counting from now */
+		events->last_tick = __sb_events_now();
+	} else {
+		/* the wheel lags the clock until it next advances, wait that out too */
+		elapsed = __sb_events_now() - events->last_tick;
+		ticks += (unsigned)((elapsed + SB_EVENTS_TICK - 1) / SB_EVENTS_TICK);
+	}
+	timer->callback = callback;
+	timer->data = data;
+	/* full turns of the wheel to skip before this timer is due */
+	timer->rounds = (ticks - 1) / SB_EVENTS_WHEEL_SIZE;
+	__sb_events_timer_link(&events->wheel[(events->tick + ticks) & (SB_EVENTS_WHEEL_SIZE - 1)], timer);
+	++events->timers;
+}
+
+__songbird_header__
+void sb_events_timer_cancel(sb_events_t *events, sb_events_timer_t *timer) {
+	if(timer->next == NULL) {
+		return;
+	}
+	__sb_events_timer_unlink(timer);
+	--events->timers;
+}
+
+/**
+ * Advances the timer wheel to the current time, running every timer that
+ * expires on the way. This function is not designed to be called by the
+ * end user.
+ */
+__songbird_header__
+void __sb_events_expire(sb_events_t *events) {
+	unsigned long now = __sb_events_now();
+	sb_events_timer_t expired;
+	sb_events_timer_t *timer, *next, *head;
+	while(now - events->last_tick >= SB_EVENTS_TICK) {
+		if(events->timers == 0) {
+			events->last_tick = now;
+			return;
+		}
+		events->last_tick += SB_EVENTS_TICK;
+		events->tick = (events->tick + 1) & (SB_EVENTS_WHEEL_SIZE - 1);
+		/* collect first, callbacks may cancel or add timers */
+		expired.next = &expired;
+		expired.prev = &expired;
+		head = &events->wheel[events->tick];
+		for(timer = head->next; timer != head; timer = next) {
+			next = timer->next;
+			if(timer->rounds > 0) {
+				--timer->rounds;
+				continue;
+			}
+			__sb_events_timer_unlink(timer);
+			__sb_events_timer_link(&expired, timer);
+		}
+		while(expired.next != &expired) {
+			timer = expired.next;
+			__sb_events_timer_unlink(timer);
+			--events->timers;
+			timer->callback(events, timer->data);
+		}
+	}
+}
+
+/**
+ * Shortens the timeout so the loop wakes up for the next tick while any
+ * timers are pending. This function is not designed to be called by the
+ * end user.
+ */
+__songbird_header__
+int __sb_events_timeout(sb_events_t *events, int timeout) {
+	unsigned long elapsed;
+	int wait;
+	if(events->timers == 0) {
+		return timeout;
+	}
+	elapsed = __sb_events_now() - events->last_tick;
+	wait = elapsed >= SB_EVENTS_TICK ? 0 : (int)(SB_EVENTS_TICK - elapsed);
+	if(timeout < 0 || wait < timeout) {
+		return wait;
+	}
+	return timeout;
+}
+
+__songbird_header__
+void __sb_events_dispatch(sb_events_t *events, int fd, unsigned ready) {
+	struct __sb_event_slot *slot;
+	if(fd < 0 || (unsigned)fd >= events->slot_count) {
+		return;
+	}
+	slot = &events->slots[fd];
+	/* an earlier callback in this round may have removed it */
+	if(!slot->active || slot->callback == NULL) {
+		return;
+	}
+	slot->callback(events, fd, ready, slot->data);
+}
+
+__songbird_header__
+int sb_events_poll(sb_events_t *events, int timeout) {
+	int count, i;
+	unsigned ready;
+#ifdef __SB_EVENTS_EPOLL__
+	struct epoll_event batch[SB_EVENTS_BATCH];
+	count = epoll_wait(events->epoll, batch, SB_EVENTS_BATCH,
+			__sb_events_timeout(events, timeout));
+	if(count < 0) {
+		if(errno != EINTR) {
+			return -1;
+		}
+		count = 0;
+	}
+	for(i = 0; i < count; ++i) {
+		ready = 0;
+		if(batch[i].events & (EPOLLIN | EPOLLRDHUP)) {
+			ready |= SB_EVENT_READ;
+		}
+		if(batch[i].events & EPOLLOUT) {
+			ready |= SB_EVENT_WRITE;
+		}
+		if(batch[i].events & EPOLLERR) {
+			ready |= SB_EVENT_ERROR;
+		}
+		if(batch[i].events & (EPOLLHUP | EPOLLRDHUP)) {
+			ready |= SB_EVENT_HANGUP;
+		}
+		__sb_events_dispatch(events, batch[i].data.fd, ready);
+	}
+#else
+	int fds[SB_EVENTS_BATCH];
+	unsigned readies[SB_EVENTS_BATCH];
+	int found = 0;
+	count = poll(events->polls, events->poll_count,
+			__sb_events_timeout(events, timeout));
+	if(count < 0) {
+		if(errno != EINTR) {
+			return -1;
+		}
+		count = 0;
+	}
+	/* copy out first, callbacks may reorder polls by removing descriptors */
+	for(i = 0; i < (int)events->poll_count && found < count && found < SB_EVENTS_BATCH; ++i) {
+		short revents = events->polls[i].revents;
+		if(revents == 0) {
+			continue;
+		}
+		ready = 0;
+		if(revents & POLLIN) {
+			ready |= SB_EVENT_READ;
+		}
+		if(revents & POLLOUT) {
+			ready |= SB_EVENT_WRITE;
+		}
+		if(revents & (POLLERR | POLLNVAL)) {
+			ready |= SB_EVENT_ERROR;
+		}
+		if(revents & POLLHUP) {
+			ready |= SB_EVENT_HANGUP;
+		}
+		fds[found] = events->polls[i].fd;
+		readies[found] = ready;
+		++found;
+	}
+	count = found;
+	for(i = 0; i < count; ++i) {
+		__sb_events_dispatch(events, fds[i], readies[i]);
+	}
+#endif
+	__sb_events_expire(events);
+	return count;
+}
+
+__songbird_header__
+int sb_events_run(sb_events_t *events) {
+	events->running = 1;
+	while(events->running) {
+		if(sb_events_poll(events, -1) < 0) {
+			events->running = 0;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+__songbird_header__
+void sb_events_stop(sb_events_t *events) {
+	events->running = 0;
+}
+
+#ifdef _WIN32
+#undef poll
+#endif
+
+#undef __songbird_header__
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SONGBIRD_EVENTS_H__ */
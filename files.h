@@ -23,8 +23,40 @@
 #ifndef __SONGBIRD_FILES_H__
 #define __SONGBIRD_FILES_H__
 
+/*
+ * Strict C modes hide the POSIX and BSD functions used below, and Linux only
+ * declares syncfs with _GNU_SOURCE. This asks for them, but only works if no
+ * system header was included before this file, otherwise compile with
+ * _GNU_SOURCE (_DEFAULT_SOURCE off Linux) defined.
+ */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#elif !defined(_WIN32) && !defined(_DEFAULT_SOURCE) && !defined(_GNU_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 /* If you don't have IO don't include this file... */
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+/* glibc only declares it if _GNU_SOURCE was seen before its first header */
+#if defined(__linux__) && defined(_GNU_SOURCE) && (!defined(__GLIBC__) || defined(__USE_GNU))
+#define __SB_FILE_SYNCFS__
+#endif
+#endif
 
 #ifndef __SB_NO_ALLOC__
 #include <stdlib.h>
@@ -49,6 +81,144 @@ __songbird_header__	void *sb_file_load(char const *, unsigned const);
 __songbird_header__	void *sb_file_load2(char const *, unsigned *);
 __songbird_header__	void sb_file_write(char const *, void const *, unsigned const);
 
+/* Flags for sb_file_map */
+enum {
+	/* writable, but changes stay in this process and never reach the file */
+	SB_FILE_MAP_PRIVATE = 1,
+	/* hint that the mapping will be read front to back */
+	SB_FILE_MAP_SEQUENTIAL = 2,
+	/* hint that the mapping will be read in no particular order */
+	SB_FILE_MAP_RANDOM = 4,
+	/* hint that the whole mapping will be needed soon, starts reading it in */
+	SB_FILE_MAP_WILLNEED = 8,
+	/* read the whole file in before returning */
+	SB_FILE_MAP_POPULATE = 16
+};
+
+/*
+ * Maps the whole file into memory, read only unless SB_FILE_MAP_PRIVATE is
+ * given. Processes mapping the same file share the pages of the page cache.
+ * Returns NULL on failure or if the file is empty, the size is stored in the
+ * second argument either way.
+ */
+__songbird_header__	void *sb_file_map(char const *, size_t *, unsigned);
+__songbird_header__	void sb_file_unmap(void *, size_t);
+
+/*
+ * File sizes and offsets. This is 64 bits everywhere except 32 bit POSIX
+ * systems built without _FILE_OFFSET_BITS=64.
+ */
+#ifdef _WIN32
+typedef __int64 sb_file_off_t;
+#else
+typedef off_t sb_file_off_t;
+#endif
+
+/* returns the size of the file, -1 if it can not be found */
+__songbird_header__	sb_file_off_t sb_file_size64(char const *);
+
+enum {
+	/* default chunk size for the file streams */
+	SB_FILE_CHUNK = 1 << 20,
+	/* chunk buffers are aligned to this */
+	SB_FILE_ALIGN = 4096
+};
+
+/*
+ * A file read or written in fixed size chunks, so files of any size can be
+ * processed in constant memory. It is highly recommended you do not change
+ * any values in this structure manually.
+ */
+typedef struct sb_file_stream {
+	FILE *file;
+	unsigned char *chunk;
+	unsigned capacity;
+	/* bytes waiting in chunk, writers only */
+	unsigned len;
+	/* position of the next byte read or written */
+	sb_file_off_t offset;
+	/* the size of the file when it was opened, readers only */
+	sb_file_off_t size;
+	int error;
+	void *raw;
+} sb_file_stream_t;
+
+/* called for every chunk read, returning non zero stops the reading */
+typedef int (*sb_file_chunk_f)(void *, void const *, unsigned, sb_file_off_t);
+
+/* opens a file for reading with the given chunk size (0 for SB_FILE_CHUNK), returns -1 on failure */
+__songbird_header__	int sb_file_reader_open(sb_file_stream_t *, char const *, unsigned);
+/* points at the next chunk, returns 1 for a chunk, 0 at the end of the file and -1 on failure */
+__songbird_header__	int sb_file_reader_next(sb_file_stream_t *, void const **, unsigned *);
+__songbird_header__	void sb_file_reader_close(sb_file_stream_t *);
+/* calls the function with the given context for every chunk, returns -1 on failure */
+__songbird_header__	int sb_file_read_chunks(char const *, unsigned, sb_file_chunk_f, void *);
+
+/* creates or truncates a file for writing with the given chunk size (0 for SB_FILE_CHUNK), returns -1 on failure */
+__songbird_header__	int sb_file_writer_open(sb_file_stream_t *, char const *, unsigned);
+/* adds bytes to the file, writing whole chunks as they fill, returns -1 on failure */
+__songbird_header__	int sb_file_writer_write(sb_file_stream_t *, void const *, unsigned);
+/* writes whatever is left and closes the file, returns -1 if any write failed */
+__songbird_header__	int sb_file_writer_close(sb_file_stream_t *);
+
+/* The outcome of loading one file with sb_file_load_many */
+typedef struct sb_file_result {
+	/* the contents, inside the block returned by sb_file_load_many, NULL on failure */
+	void *data;
+	size_t size;
+	/* 0, or the errno of the failure */
+	int error;
+} sb_file_result_t;
+
+/*
+ * Loads several files at once. Every file is sized with stat and opened
+ * once, all of them are read into one block (free it with sb_free) and the
+ * reads are spread over the given number of threads (0 or 1 to read them in
+ * this thread). Failures are reported per file in the results. Returns
+ * NULL if the block could not be allocated or no file could be loaded, in
+ * which case there is nothing to free.
+ */
+__songbird_header__	void *sb_file_load_many(char const **, unsigned, sb_file_result_t *, unsigned);
+
+#ifndef _WIN32
+/*
+ * Replaces a file so that after a crash it holds either the old or the new
+ * contents, never part of either. The data goes to a temporary file next to
+ * it which is then renamed over it and keeps the permissions of the file it
+ * replaces. With sync set the data and the rename are flushed to disk before
+ * returning. Returns -1 on failure, leaving the old file as it was.
+ */
+__songbird_header__	int sb_file_write_atomic(char const *, void const *, size_t, int);
+
+/*
+ * Group commit for atomic writes. Every write goes to its temporary file
+ * right away, sb_file_batch_commit then makes all of them durable together
+ * with one flush and one directory sync per directory, instead of several
+ * per file. On Linux the flush is a syncfs per directory, which writes out
+ * everything dirty on that file system, other processes' data included.
+ * Elsewhere each temporary file is flushed on its own. It is highly
+ * recommended you do not change any values in this structure manually.
+ */
+typedef struct sb_file_batch {
+	struct __sb_file_batch_entry *entries;
+	unsigned count;
+	unsigned capacity;
+} sb_file_batch_t;
+
+__songbird_header__	void sb_file_batch_init(sb_file_batch_t *);
+/* writes the temporary file for a later commit, returns -1 on failure */
+__songbird_header__	int sb_file_batch_write(sb_file_batch_t *, char const *, void const *, size_t);
+/*
+ * Makes every pending write durable and visible, returns -1 if any failed.
+ * If the flush fails no file is replaced. A rename failing halfway leaves
+ * the files before it replaced and the ones after it untouched, the batch
+ * is atomic per file, not as a whole.
+ */
+__songbird_header__	int sb_file_batch_commit(sb_file_batch_t *);
+/* throws away pending writes, the files keep their old contents */
+__songbird_header__	void sb_file_batch_free(sb_file_batch_t *);
+#endif
+
 __songbird_header__
 unsigned sb_file_size(char const *filename) {
 	FILE *f;
@@ -87,6 +257,770 @@ void sb_file_write(char const *filename, void const *ptr, unsigned const size) {
 	fclose(f);
 }
 
+__songbird_header__
+void *sb_file_map(char const *filename, size_t *size, unsigned flags) {
+#ifdef _WIN32
+	HANDLE file, mapping;
+	LARGE_INTEGER file_size;
+	void *ptr = NULL;
+	int priv = (flags & SB_FILE_MAP_PRIVATE) != 0;
+	*size = 0;
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			(flags & SB_FILE_MAP_SEQUENTIAL) ? FILE_FLAG_SEQUENTIAL_SCAN :
+			(flags & SB_FILE_MAP_RANDOM) ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+	if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return NULL;
+	}
+	*size = (size_t)file_size.QuadPart;
+	mapping = CreateFileMappingA(file, NULL, priv ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	if(mapping != NULL) {
+		ptr = MapViewOfFile(mapping, priv ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+		/* the view keeps the mapping alive */
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+	if(ptr != NULL && (flags & SB_FILE_MAP_POPULATE)) {
+		volatile unsigned char const *bytes = (unsigned char const *)ptr;
+		size_t i;
+		for(i = 0; i < *size; i += 4096) {
+			(void)bytes[i];
+		}
+	}
+	return ptr;
+#else
+	struct stat info;
+	void *ptr;
+	int mmap_flags;
+	int fd = open(filename, O_RDONLY);
+	*size = 0;
+	if(fd < 0) {
+		return NULL;
+	}
+	if(fstat(fd, &info) < 0 || info.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	*size = (size_t)info.st_size;
+	mmap_flags = (flags & SB_FILE_MAP_PRIVATE) ? MAP_PRIVATE : MAP_SHARED;
+#ifdef MAP_POPULATE
+	if(flags & SB_FILE_MAP_POPULATE) {
+		mmap_flags |= MAP_POPULATE;
+	}
+#endif
+	ptr = mmap(NULL, *size, (flags & SB_FILE_MAP_PRIVATE) ? PROT_READ | PROT_WRITE : PROT_READ,
+			mmap_flags, fd, 0);
+	/* the mapping keeps the file open */
+	close(fd);
+	if(ptr == MAP_FAILED) {
+		return NULL;
+	}
+#ifdef POSIX_MADV_SEQUENTIAL
+	if(flags & SB_FILE_MAP_SEQUENTIAL) {
+		posix_madvise(ptr, *size, POSIX_MADV_SEQUENTIAL);
+	}
+	if(flags & SB_FILE_MAP_RANDOM) {
+		posix_madvise(ptr, *size, POSIX_MADV_RANDOM);
+	}
+	if(flags & SB_FILE_MAP_WILLNEED) {
+		posix_madvise(ptr, *size, POSIX_MADV_WILLNEED);
+	}
+#endif
+#ifndef MAP_POPULATE
+	if(flags & SB_FILE_MAP_POPULATE) {
+		volatile unsigned char const *bytes = (unsigned char const *)ptr;
+		size_t i;
+		for(i = 0; i < *size; i += 4096) {
+			(void)bytes[i];
+		}
+	}
+#endif
+	return ptr;
+#endif
+}
+
+__songbird_header__
+void sb_file_unmap(void *ptr, size_t size) {
+	if(ptr == NULL) {
+		return;
+	}
+#ifdef _WIN32
+	(void)size;
+	UnmapViewOfFile(ptr);
+#else
+	munmap(ptr, size);
+#endif
+}
+
+__songbird_header__
+sb_file_off_t sb_file_size64(char const *filename) {
+#ifdef _WIN32
+	struct _stati64 info;
+	if(_stati64(filename, &info) < 0) {
+		return -1;
+	}
+#else
+	struct stat info;
+	if(stat(filename, &info) < 0) {
+		return -1;
+	}
+#endif
+	return (sb_file_off_t)info.st_size;
+}
+
+/**
+ * Opens the file unbuffered with an aligned chunk buffer of its own.
+ * This function is not designed to be called by the end user.
+ */
+__songbird_header__
+int __sb_file_stream_open(sb_file_stream_t *stream, char const *filename, char const *mode, unsigned chunk) {
+	size_t address;
+	memset(stream, 0, sizeof(sb_file_stream_t));
+	if(chunk == 0) {
+		chunk = SB_FILE_CHUNK;
+	}
+	stream->raw = sb_malloc(chunk + SB_FILE_ALIGN);
+	if(stream->raw == NULL) {
+		return -1;
+	}
+	address = (size_t)stream->raw;
+	address = (address + SB_FILE_ALIGN - 1) & ~(size_t)(SB_FILE_ALIGN - 1);
+	stream->chunk = (unsigned char *)address;
+	stream->capacity = chunk;
+	stream->file = fopen(filename, mode);
+	if(stream->file == NULL) {
+		sb_free(stream->raw);
+		stream->raw = NULL;
+		return -1;
+	}
+	/* whole chunks go straight to the system, stdio would only copy them again */
+	setvbuf(stream->file, NULL, _IONBF, 0);
+	return 0;
+}
+
+__songbird_header__
+void __sb_file_stream_close(sb_file_stream_t *stream) {
+	if(stream->file) {
+		fclose(stream->file);
+	}
+	sb_free(stream->raw);
+	stream->file = NULL;
+	stream->raw = NULL;
+	stream->chunk = NULL;
+}
+
+__songbird_header__
+int sb_file_reader_open(sb_file_stream_t *stream, char const *filename, unsigned chunk) {
+	if(__sb_file_stream_open(stream, filename, "rb", chunk)) {
+		return -1;
+	}
+	stream->size = sb_file_size64(filename);
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+	posix_fadvise(fileno(stream->file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	return 0;
+}
+
+__songbird_header__
+int sb_file_reader_next(sb_file_stream_t *stream, void const **data, unsigned *len) {
+	size_t got;
+	if(stream->error) {
+		return -1;
+	}
+	got = fread(stream->chunk, 1, stream->capacity, stream->file);
+	if(got == 0) {
+		if(ferror(stream->file)) {
+			stream->error = 1;
+			return -1;
+		}
+		return 0;
+	}
+	*data = stream->chunk;
+	*len = (unsigned)got;
+	stream->offset += (sb_file_off_t)got;
+	return 1;
+}
+
+__songbird_header__
+void sb_file_reader_close(sb_file_stream_t *stream) {
+	__sb_file_stream_close(stream);
+}
+
+__songbird_header__
+int sb_file_read_chunks(char const *filename, unsigned chunk, sb_file_chunk_f callback, void *context) {
+	sb_file_stream_t stream;
+	void const *data;
+	unsigned len;
+	sb_file_off_t offset;
+	int result;
+	if(sb_file_reader_open(&stream, filename, chunk)) {
+		return -1;
+	}
+	for(;;) {
+		offset = stream.offset;
+		result = sb_file_reader_next(&stream, &data, &len);
+		if(result <= 0) {
+			break;
+		}
+		if(callback(context, data, len, offset)) {
+			result = 0;
+			break;
+		}
+	}
+	sb_file_reader_close(&stream);
+	return result < 0 ? -1 : 0;
+}
+
+__songbird_header__
+int sb_file_writer_open(sb_file_stream_t *stream, char const *filename, unsigned chunk) {
+	return __sb_file_stream_open(stream, filename, "wb", chunk);
+}
+
+__songbird_header__
+int __sb_file_writer_flush(sb_file_stream_t *stream) {
+	if(stream->len == 0) {
+		return 0;
+	}
+	if(fwrite(stream->chunk, 1, stream->len, stream->file) != stream->len) {
+		stream->error = 1;
+		return -1;
+	}
+	stream->len = 0;
+	return 0;
+}
+
+__songbird_header__
+int sb_file_writer_write(sb_file_stream_t *stream, void const *ptr, unsigned len) {
+	unsigned char const *bytes = (unsigned char const *)ptr;
+	unsigned room;
+	if(stream->error) {
+		return -1;
+	}
+	while(len > 0) {
+		if(stream->len == 0 && len >= stream->capacity) {
+			/* whole chunks skip the copy */
+			if(fwrite(bytes, 1, stream->capacity, stream->file) != stream->capacity) {
+				stream->error = 1;
+				return -1;
+			}
+			room = stream->capacity;
+		} else {
+			room = stream->capacity - stream->len;
+			if(room > len) {
+				room = len;
+			}
+			memcpy(stream->chunk + stream->len, bytes, room);
+			stream->len += room;
+			if(stream->len == stream->capacity && __sb_file_writer_flush(stream)) {
+				return -1;
+			}
+		}
+		bytes += room;
+		len -= room;
+		stream->offset += room;
+	}
+	return 0;
+}
+
+__songbird_header__
+int sb_file_writer_close(sb_file_stream_t *stream) {
+	int result = 0;
+	if(stream->file == NULL) {
+		return -1;
+	}
+	if(__sb_file_writer_flush(stream) || stream->error) {
+		result = -1;
+	}
+	if(fclose(stream->file)) {
+		result = -1;
+	}
+	stream->file = NULL;
+	__sb_file_stream_close(stream);
+	return result;
+}
+
+/* context shared by the sb_file_load_many workers */
+struct __sb_file_load_job {
+	char const **filenames;
+	sb_file_result_t *results;
+	unsigned count;
+	unsigned next;
+#ifndef _WIN32
+	pthread_mutex_t lock;
+#endif
+};
+
+__songbird_header__
+void __sb_file_load_one(char const *filename, sb_file_result_t *result) {
+#ifdef _WIN32
+	FILE *f;
+	size_t got;
+	f = fopen(filename, "rb");
+	if(f == NULL) {
+		result->error = errno ? errno : ENOENT;
+		result->data = NULL;
+		return;
+	}
+	got = fread(result->data, 1, result->size, f);
+	if(got < result->size && ferror(f)) {
+		result->error = EIO;
+	}
+	result->size = got;
+	fclose(f);
+#else
+	size_t total = 0;
+	ssize_t got;
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		result->error = errno;
+		result->data = NULL;
+		return;
+	}
+	while(total < result->size) {
+		got = read(fd, (char *)result->data + total, result->size - total);
+		if(got < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			result->error = errno;
+			break;
+		}
+		if(got == 0) {
+			break; /* shrank since it was sized */
+		}
+		total += (size_t)got;
+	}
+	result->size = total;
+	close(fd);
+#endif
+	if(result->error) {
+		result->data = NULL;
+		result->size = 0;
+	}
+}
+
+__songbird_header__
+void *__sb_file_load_worker(void *arg) {
+	struct __sb_file_load_job *job = (struct __sb_file_load_job *)arg;
+	unsigned index;
+	for(;;) {
+#ifndef _WIN32
+		pthread_mutex_lock(&job->lock);
+#endif
+		/* hand out one file at a time so big files do not hold up the rest */
+		index = job->next++;
+#ifndef _WIN32
+		pthread_mutex_unlock(&job->lock);
+#endif
+		if(index >= job->count) {
+			break;
+		}
+		if(job->results[index].data != NULL) {
+			__sb_file_load_one(job->filenames[index], &job->results[index]);
+		}
+	}
+	return NULL;
+}
+
+__songbird_header__
+void *sb_file_load_many(char const **filenames, unsigned count, sb_file_result_t *results, unsigned threads) {
+	struct __sb_file_load_job job;
+	sb_file_off_t size;
+	size_t total = 0, offset = 0;
+	unsigned char *block;
+	unsigned i;
+	/* size everything first so there is only one allocation */
+	for(i = 0; i < count; ++i) {
+		size = sb_file_size64(filenames[i]);
+		results[i].data = NULL;
+		results[i].error = 0;
+		results[i].size = 0;
+		if(size < 0) {
+			results[i].error = errno ? errno : ENOENT;
+			continue;
+		}
+		results[i].size = (size_t)size;
+		/* keep every file aligned for whatever it holds */
+		total += ((size_t)size + 15) & ~(size_t)15;
+	}
+	block = (unsigned char *)sb_malloc(total ? total : 1);
+	if(block == NULL) {
+		for(i = 0; i < count; ++i) {
+			if(results[i].error == 0) {
+				results[i].error = ENOMEM;
+				results[i].size = 0;
+			}
+		}
+		return NULL;
+	}
+	for(i = 0; i < count; ++i) {
+		if(results[i].error == 0) {
+			results[i].data = block + offset;
+			offset += (results[i].size + 15) & ~(size_t)15;
+		}
+	}
+	job.filenames = filenames;
+	job.results = results;
+	job.count = count;
+	job.next = 0;
+#ifdef _WIN32
+	(void)threads;
+	__sb_file_load_worker(&job);
+#else
+	if(threads > count) {
+		threads = count;
+	}
+	if(threads <= 1) {
+		pthread_mutex_init(&job.lock, NULL);
+		__sb_file_load_worker(&job);
+	} else {
+		pthread_t *workers = (pthread_t *)sb_malloc(sizeof(pthread_t) * threads);
+		unsigned started = 0;
+		pthread_mutex_init(&job.lock, NULL);
+		if(workers != NULL) {
+			for(; started < threads; ++started) {
+				if(pthread_create(&workers[started], NULL, __sb_file_load_worker, &job)) {
+					break;
+				}
+			}
+		}
+		/* this thread helps too, and does it all if no thread started */
+		__sb_file_load_worker(&job);
+		for(i = 0; i < started; ++i) {
+			pthread_join(workers[i], NULL);
+		}
+		sb_free(workers);
+	}
+	pthread_mutex_destroy(&job.lock);
+#endif
+	for(i = 0; i < count; ++i) {
+		if(results[i].data != NULL) {
+			return block;
+		}
+	}
+	/* every file failed */
+	sb_free(block);
+	return NULL;
+}
+
+#ifndef _WIN32
+
+struct __sb_file_batch_entry {
+	char *temp;
+	char *target;
+	char *dir;
+};
+
+__songbird_header__
+int __sb_file_datasync(int fd) {
+#if defined(__APPLE__) && defined(F_FULLFSYNC)
+	/* fsync on macOS does not reach the platter */
+	if(fcntl(fd, F_FULLFSYNC) == 0) {
+		return 0;
+	}
+	return fsync(fd);
+#elif defined(__linux__)
+	return fdatasync(fd);
+#else
+	return fsync(fd);
+#endif
+}
+
+/**
+ * Returns a copy of the directory part of the path, "." if there is none.
+ * This function is not designed to be called by the end user.
+ */
+__songbird_header__
+char *__sb_file_dirname(char const *filename) {
+	char const *slash = strrchr(filename, '/');
+	size_t len = slash ? (size_t)(slash - filename) : 1;
+	char *dir;
+	if(slash == filename) {
+		len = 1; /* the root */
+	}
+	dir = (char *)sb_malloc(len + 1);
+	if(dir == NULL) {
+		return NULL;
+	}
+	if(slash) {
+		memcpy(dir, filename, len);
+	} else {
+		dir[0] = '.';
+	}
+	dir[len] = '\0';
+	return dir;
+}
+
+__songbird_header__
+int __sb_file_sync_dir(char const *filename) {
+	int result;
+	int fd;
+	char *dir = __sb_file_dirname(filename);
+	if(dir == NULL) {
+		return -1;
+	}
+	fd = open(dir, O_RDONLY);
+	sb_free(dir);
+	if(fd < 0) {
+		return -1;
+	}
+	result = fsync(fd);
+	close(fd);
+	return result;
+}
+
+/**
+ * Writes the data to a new temporary file next to filename and returns its
+ * name, or NULL on failure. The file is flushed if sync is set.
+ * This function is not designed to be called by the end user.
+ */
+__songbird_header__
+char *__sb_file_write_temp(char const *filename, void const *ptr, size_t size, int sync) {
+	static unsigned counter = 0;
+	size_t len = strlen(filename);
+	char *temp = (char *)sb_malloc(len + 40);
+	size_t written = 0;
+	ssize_t result;
+	struct stat st;
+	int fd = -1;
+	int tries;
+	if(temp == NULL) {
+		return NULL;
+	}
+	for(tries = 0; tries < 100 && fd < 0; ++tries) {
+		sprintf(temp, "%s.%ld.%u.tmp", filename, (long)getpid(), counter++);
+		fd = open(temp, O_WRONLY | O_CREAT | O_EXCL, 0666);
+		if(fd < 0 && errno != EEXIST) {
+			break;
+		}
+	}
+	if(fd < 0) {
+		sb_free(temp);
+		return NULL;
+	}
+	/* the replacement keeps the permissions of the file it replaces */
+	if(stat(filename, &st) == 0) {
+		fchmod(fd, st.st_mode & 07777);
+	}
+	while(written < size) {
+		result = write(fd, (char const *)ptr + written, size - written);
+		if(result < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		written += (size_t)result;
+	}
+	if(written < size || (sync && __sb_file_datasync(fd))) {
+		close(fd);
+		unlink(temp);
+		sb_free(temp);
+		return NULL;
+	}
+	if(close(fd)) {
+		unlink(temp);
+		sb_free(temp);
+		return NULL;
+	}
+	return temp;
+}
+
+__songbird_header__
+int sb_file_write_atomic(char const *filename, void const *ptr, size_t size, int sync) {
+	char *temp = __sb_file_write_temp(filename, ptr, size, sync);
+	if(temp == NULL) {
+		return -1;
+	}
+	if(rename(temp, filename)) {
+		unlink(temp);
+		sb_free(temp);
+		return -1;
+	}
+	sb_free(temp);
+	/* the rename itself is only durable once the directory is */
+	if(sync && __sb_file_sync_dir(filename)) {
+		return -1;
+	}
+	return 0;
+}
+
+__songbird_header__
+void sb_file_batch_init(sb_file_batch_t *batch) {
+	batch->entries = NULL;
+	batch->count = 0;
+	batch->capacity = 0;
+}
+
+__songbird_header__
+int sb_file_batch_write(sb_file_batch_t *batch, char const *filename, void const *ptr, size_t size) {
+	struct __sb_file_batch_entry *entry;
+	size_t len;
+	if(batch->count == batch->capacity) {
+		unsigned capacity = batch->capacity ? batch->capacity * 2 : 16;
+		struct __sb_file_batch_entry *entries = (struct __sb_file_batch_entry *)sb_realloc(
+				batch->entries, sizeof(struct __sb_file_batch_entry) * capacity);
+		if(entries == NULL) {
+			return -1;
+		}
+		batch->entries = entries;
+		batch->capacity = capacity;
+	}
+	entry = &batch->entries[batch->count];
+	len = strlen(filename);
+	entry->target = (char *)sb_malloc(len + 1);
+	if(entry->target == NULL) {
+		return -1;
+	}
+	memcpy(entry->target, filename, len + 1);
+	entry->dir = __sb_file_dirname(filename);
+	if(entry->dir == NULL) {
+		sb_free(entry->target);
+		return -1;
+	}
+	/* not flushed yet, the commit flushes everything at once */
+	entry->temp = __sb_file_write_temp(filename, ptr, size, 0);
+	if(entry->temp == NULL) {
+		sb_free(entry->dir);
+		sb_free(entry->target);
+		return -1;
+	}
+	++batch->count;
+	return 0;
+}
+
+/**
+ * Orders directory names for qsort. This function is not designed to be
+ * called by the end user.
+ */
+__songbird_header__
+int __sb_file_compare_dirs(void const *a, void const *b) {
+	return strcmp(*(char const * const *)a, *(char const * const *)b);
+}
+
+/**
+ * Lists every directory of the batch once, sorted, and stores how many
+ * there are. Returns NULL on failure. This function is not designed to be
+ * called by the end user.
+ */
+__songbird_header__
+char **__sb_file_batch_dirs(sb_file_batch_t *batch, unsigned *count) {
+	char **dirs = (char **)sb_malloc(sizeof(char *) * batch->count);
+	unsigned i, unique = 0;
+	if(dirs == NULL) {
+		return NULL;
+	}
+	for(i = 0; i < batch->count; ++i) {
+		dirs[i] = batch->entries[i].dir;
+	}
+	qsort(dirs, batch->count, sizeof(char *), __sb_file_compare_dirs);
+	for(i = 0; i < batch->count; ++i) {
+		if(unique == 0 || strcmp(dirs[unique - 1], dirs[i]) != 0) {
+			dirs[unique++] = dirs[i];
+		}
+	}
+	*count = unique;
+	return dirs;
+}
+
+/**
+ * Opens the directory and flushes it, with syncfs the whole file system it
+ * is on. This function is not designed to be called by the end user.
+ */
+__songbird_header__
+int __sb_file_batch_sync(char const *dir, int whole) {
+	int result;
+	int fd = open(dir, O_RDONLY);
+	if(fd < 0) {
+		return -1;
+	}
+#ifdef __SB_FILE_SYNCFS__
+	result = whole ? syncfs(fd) : fsync(fd);
+#else
+	(void)whole;
+	result = fsync(fd);
+#endif
+	close(fd);
+	return result;
+}
+
+__songbird_header__
+int sb_file_batch_commit(sb_file_batch_t *batch) {
+	struct __sb_file_batch_entry *entry;
+	char **dirs;
+	unsigned i, count = 0;
+	int result = 0;
+#ifndef __SB_FILE_SYNCFS__
+	int fd;
+#endif
+	if(batch->count == 0) {
+		return 0;
+	}
+	dirs = __sb_file_batch_dirs(batch, &count);
+	if(dirs == NULL) {
+		result = -1;
+	}
+	/* 1. flush the data of every temporary file */
+#ifdef __SB_FILE_SYNCFS__
+	/* one syncfs per directory flushes everything on its file system */
+	for(i = 0; i < count; ++i) {
+		if(__sb_file_batch_sync(dirs[i], 1)) {
+			result = -1;
+		}
+	}
+#else
+	for(i = 0; result == 0 && i < batch->count; ++i) {
+		fd = open(batch->entries[i].temp, O_RDONLY);
+		if(fd < 0 || __sb_file_datasync(fd)) {
+			result = -1;
+		}
+		if(fd >= 0) {
+			close(fd);
+		}
+	}
+#endif
+	/* 2. swap them in, if the data did not make it leave the old files alone */
+	for(i = 0; i < batch->count; ++i) {
+		entry = &batch->entries[i];
+		if(result || rename(entry->temp, entry->target)) {
+			unlink(entry->temp);
+			result = -1;
+		}
+	}
+	/* 3. make the renames durable, once per directory */
+	for(i = 0; i < count; ++i) {
+		if(__sb_file_batch_sync(dirs[i], 0)) {
+			result = -1;
+		}
+	}
+	sb_free(dirs);
+	for(i = 0; i < batch->count; ++i) {
+		sb_free(batch->entries[i].temp);
+		sb_free(batch->entries[i].target);
+		sb_free(batch->entries[i].dir);
+	}
+	batch->count = 0;
+	return result;
+}
+
+__songbird_header__
+void sb_file_batch_free(sb_file_batch_t *batch) {
+	unsigned i;
+	for(i = 0; i < batch->count; ++i) {
+		unlink(batch->entries[i].temp);
+		sb_free(batch->entries[i].temp);
+		sb_free(batch->entries[i].target);
+		sb_free(batch->entries[i].dir);
+	}
+	sb_free(batch->entries);
+	sb_file_batch_init(batch);
+}
+
+#endif /* _WIN32 */
+
 #undef __songbird_header__
 
 #ifdef __cplusplus
@@ -0,0 +1,551 @@
+/**
+ * Copyright (c) 2014-2017 Robert Maupin <chasesan@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SONGBIRD_HEAP_H__
+#define __SONGBIRD_HEAP_H__
+
+#ifndef __SB_NO_ALLOC__
+#include <stdlib.h>
+#define sb_malloc malloc
+#define sb_realloc realloc
+#define sb_free free
+#endif /* __SB_NO_ALLOC__ */
+
+#ifndef __SB_ALLOCATOR__
+#define __SB_ALLOCATOR__
+#include <stddef.h>
+/*
+ * A runtime allocator, handed to a container when it is initialized. A NULL
+ * allocator stands for sb_malloc, sb_realloc and sb_free. The allocator has
+ * to outlive every container using it and release has to accept NULL.
+ * alloc.h provides arena and pool allocators.
+ */
+typedef struct sb_allocator {
+	void *(*alloc)(void *context, size_t size);
+	void *(*resize)(void *context, void *ptr, size_t size);
+	void (*release)(void *context, void *ptr);
+	void *context;
+} sb_allocator_t;
+#define __sb_allocate(a, size) \
+	((a) ? (a)->alloc((a)->context, (size)) : sb_malloc(size))
+#define __sb_reallocate(a, ptr, size) \
+	((a) ? (a)->resize((a)->context, (ptr), (size)) : sb_realloc((ptr), (size)))
+#define __sb_deallocate(a, ptr) \
+	((a) ? (a)->release((a)->context, (ptr)) : sb_free(ptr))
+#endif
+
+#include <string.h>
+
+#ifdef __cplusplus
+/* Not sure why you would want to use this in C++, but just in case. */
+extern "C" {
+#define __songbird_header__	inline
+/* Works even if __STDC_VERSION__ is not defined. */
+#elif __STDC_VERSION__ <= 199409L
+#define __songbird_header__	static __inline__
+#else
+#define __songbird_header__	static inline
+#endif
+
+#ifndef __SB_ERROR__
+#define __SB_ERROR__
+enum {
+	SB_ERROR_NONE = 0,
+	SB_ERROR_MEMORY_ALLOCATION = 1,
+	SB_ERROR_OUT_OF_BOUNDS = 2,
+};
+#if __STDC_VERSION__ >= 201112L && !defined __STDC_NO_THREADS__
+__thread int sb_error = SB_ERROR_NONE;
+#else
+int sb_error = SB_ERROR_NONE;
+#endif
+#define sb_error() (sb_error)
+#define sb_error_clear() (sb_error = SB_ERROR_NONE)
+#endif
+
+#ifndef __songbird_compare_func__
+#define __songbird_compare_func__
+/** gets the context and two values, negative if a goes before b, 0 if equal */
+typedef int (*sb_compare_f)(void *context, void const *a, void const *b);
+#endif
+
+/*
+ * A d-ary heap. With four children to a node the tree is half as deep as a
+ * binary heap, so pushes compare half as often, and a node's children share
+ * a cache line. Every value gets a handle when pushed, which stays the same
+ * while the value moves about the heap, so it can be updated or removed
+ * without a search.
+ */
+
+enum {
+	SB_HEAP_DEFAULT_CAPACITY = 16,
+	/* children per node */
+	SB_HEAP_ARITY = 4
+};
+
+/** never returned as a handle, sb_heap_push returns it on failure */
+#define SB_HEAP_INVALID ((unsigned)-1)
+
+/**
+ * @brief The heap structure.
+ * This is the structure used by the sb_heap_* functions. The value the
+ * comparator puts first is at the top.
+ * It is highly recommended you do not change any values in this
+ * structure manually.
+ */
+typedef struct sb_heap {
+	unsigned const size;
+	unsigned const capacity;
+	void const **entries;
+	/* the handle of every entry */
+	unsigned *handles;
+	/* the position of every handle in use, the next free one otherwise */
+	unsigned *positions;
+	unsigned free_handle;
+	sb_compare_f compare;
+	void *context;
+	sb_allocator_t const *allocator;
+} sb_heap_t;
+
+/**
+ * Initializes the specified heap. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
+ * @param heap The heap to initialize.
+ * @param compare The comparator, it must not be NULL.
+ * @param context Passed to compare.
+ */
+__songbird_header__
+void sb_heap_init(sb_heap_t *heap, sb_compare_f compare, void *context);
+
+/**
+ * Initializes the specified heap with the given capacity, taking its memory
+ * from the given allocator. sb_error is set to SB_ERROR_MEMORY_ALLOCATION if
+ * the memory allocation fails.
+ * @param heap The heap to initialize.
+ * @param capacity The initial capacity, 0 for the default.
+ * @param compare The comparator, it must not be NULL.
+ * @param context Passed to compare.
+ * @param allocator The allocator, or NULL for sb_malloc.
+ */
+__songbird_header__
+void sb_heap_init_alloc(sb_heap_t *heap, unsigned capacity,
+	sb_compare_f compare, void *context, sb_allocator_t const *allocator);
+
+/**
+ * Frees all allocated memory for the given heap.
+ * @param heap The heap to free.
+ */
+__songbird_header__
+void sb_heap_free(sb_heap_t *heap);
+
+/**
+ * Determines the size of the given heap.
+ * @param heap The heap.
+ * @return The current number of values in the heap.
+ */
+__songbird_header__
+unsigned sb_heap_size(sb_heap_t *heap);
+
+/**
+ * Makes room for the given number of values. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
+ * @param heap The heap.
+ * @param capacity The number of values.
+ */
+__songbird_header__
+void sb_heap_reserve(sb_heap_t *heap, unsigned capacity);
+
+/**
+ * Pushes a value onto the heap. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation during expansion
+ * fails.
+ * @param heap The heap.
+ * @param value The value.
+ * @return The handle of the value, or SB_HEAP_INVALID on failure.
+ */
+__songbird_header__
+unsigned sb_heap_push(sb_heap_t *heap, void const *value);
+
+/**
+ * Pushes many values onto the heap at once, restoring the order once at
+ * the end, which takes linear time instead of a push per value. sb_error is
+ * set to SB_ERROR_MEMORY_ALLOCATION if the memory allocation during
+ * expansion fails, in which case nothing is pushed.
+ * @param heap The heap.
+ * @param values The values.
+ * @param count The number of values.
+ * @param handles Where to store the handle of every value, or NULL.
+ * @return 0 on success, -1 on failure.
+ */
+__songbird_header__
+int sb_heap_push_array(sb_heap_t *heap, void const **values, unsigned count,
+	unsigned *handles);
+
+/**
+ * Gets the value at the top of the heap without removing it.
+ * @param heap The heap.
+ * @return The value, or NULL if the heap is empty.
+ */
+__songbird_header__
+void const *sb_heap_peek(sb_heap_t *heap);
+
+/**
+ * Removes the value at the top of the heap, its handle is released.
+ * @param heap The heap.
+ * @return The value, or NULL if the heap is empty.
+ */
+__songbird_header__
+void const *sb_heap_pop(sb_heap_t *heap);
+
+/**
+ * Gets the value with the given handle.
+ * @param heap The heap.
+ * @param handle A handle in use.
+ * @return The value.
+ */
+__songbird_header__
+void const *sb_heap_get(sb_heap_t *heap, unsigned handle);
+
+/**
+ * Replaces the value with the given handle and moves it to its new place,
+ * which is how a key is decreased or increased. Passing the same value
+ * again repositions it after its key changed in place.
+ * @param heap The heap.
+ * @param handle A handle in use.
+ * @param value The new value.
+ */
+__songbird_header__
+void sb_heap_update(sb_heap_t *heap, unsigned handle, void const *value);
+
+/**
+ * Removes the value with the given handle, the handle is released and may
+ * be given to a value pushed later, so it must not be used again.
+ * @param heap The heap.
+ * @param handle A handle in use.
+ * @return The value.
+ */
+__songbird_header__
+void const *sb_heap_remove(sb_heap_t *heap, unsigned handle);
+
+/* function definitions */
+
+__songbird_header__
+void sb_heap_init(sb_heap_t *heap, sb_compare_f compare, void *context) {
+	sb_heap_init_alloc(heap, 0, compare, context, NULL);
+}
+
+__songbird_header__
+void sb_heap_init_alloc(sb_heap_t *heap, unsigned capacity,
+		sb_compare_f compare, void *context, sb_allocator_t const *allocator) {
+	*(unsigned *)&heap->size = 0;
+	*(unsigned *)&heap->capacity = 0;
+	heap->entries = NULL;
+	heap->handles = NULL;
+	heap->positions = NULL;
+	heap->free_handle = SB_HEAP_INVALID;
+	heap->compare = compare;
+	heap->context = context;
+	heap->allocator = allocator;
+	sb_heap_reserve(heap, capacity ? capacity : (unsigned)SB_HEAP_DEFAULT_CAPACITY);
+}
+
+__songbird_header__
+void sb_heap_free(sb_heap_t *heap) {
+	if(!heap) {
+		return;
+	}
+	__sb_deallocate(heap->allocator, heap->entries);
+	__sb_deallocate(heap->allocator, heap->handles);
+	__sb_deallocate(heap->allocator, heap->positions);
+	heap->entries = NULL;
+	heap->handles = NULL;
+	heap->positions = NULL;
+	heap->free_handle = SB_HEAP_INVALID;
+	*(unsigned *)&heap->size = 0;
+	*(unsigned *)&heap->capacity = 0;
+}
+
+__songbird_header__
+unsigned sb_heap_size(sb_heap_t *heap) {
+	return heap->size;
+}
+
+/**
+ * Grows the arrays to at least the given capacity. This function is not
+ * designed to be called by the end user.
+ * @return 0 on success, -1 on failure.
+ */
+__songbird_header__
+int __sb_heap_reserve(sb_heap_t *heap, unsigned capacity) {
+	void *entries, *handles, *positions;
+	if(capacity <= heap->capacity) {
+		return 0;
+	}
+	/* an array that grew before another failed is kept, it is only larger */
+	entries = __sb_reallocate(heap->allocator, (void *)heap->entries,
+			sizeof(void *) * capacity);
+	if(entries == NULL) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return -1;
+	}
+	heap->entries = (void const **)entries;
+	handles = __sb_reallocate(heap->allocator, heap->handles,
+			sizeof(unsigned) * capacity);
+	if(handles == NULL) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return -1;
+	}
+	heap->handles = (unsigned *)handles;
+	positions = __sb_reallocate(heap->allocator, heap->positions,
+			sizeof(unsigned) * capacity);
+	if(positions == NULL) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return -1;
+	}
+	heap->positions = (unsigned *)positions;
+	*(unsigned *)&heap->capacity = capacity;
+	return 0;
+}
+
+__songbird_header__
+void sb_heap_reserve(sb_heap_t *heap, unsigned capacity) {
+	__sb_heap_reserve(heap, capacity);
+}
+
+/**
+ * Makes room for count more values. This function is not designed to be
+ * called by the end user.
+ * @return 0 on success, -1 on failure.
+ */
+__songbird_header__
+int __sb_heap_grow(sb_heap_t *heap, unsigned count) {
+	unsigned capacity = heap->capacity ? heap->capacity : (unsigned)SB_HEAP_DEFAULT_CAPACITY;
+	if(count >= SB_HEAP_INVALID - heap->size) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return -1;
+	}
+	while(capacity < heap->size + count) {
+		capacity = capacity * 2 > capacity ? capacity * 2 : SB_HEAP_INVALID - 1;
+	}
+	return __sb_heap_reserve(heap, capacity);
+}
+
+/**
+ * Takes an unused handle. While none have been released, the handles in use
+ * are exactly 0 to size - 1. This function is not designed to be called by
+ * the end user.
+ */
+__songbird_header__
+unsigned __sb_heap_handle(sb_heap_t *heap, unsigned size) {
+	unsigned handle = heap->free_handle;
+	if(handle == SB_HEAP_INVALID) {
+		return size;
+	}
+	heap->free_handle = heap->positions[handle];
+	return handle;
+}
+
+/**
+ * Puts an entry and its handle at the given position. This function is not
+ * designed to be called by the end user.
+ */
+__songbird_header__
+void __sb_heap_set(sb_heap_t *heap, unsigned index, void const *value,
+		unsigned handle) {
+	heap->entries[index] = value;
+	heap->handles[index] = handle;
+	heap->positions[handle] = index;
+}
+
+/**
+ * Moves the entry at the given position towards the top until its parent
+ * goes before it. This function is not designed to be called by the end
+ * user.
+ * @return The final position.
+ */
+__songbird_header__
+unsigned __sb_heap_up(sb_heap_t *heap, unsigned index) {
+	void const *value = heap->entries[index];
+	unsigned handle = heap->handles[index];
+	unsigned parent;
+	while(index > 0) {
+		parent = (index - 1) / SB_HEAP_ARITY;
+		if(heap->compare(heap->context, value, heap->entries[parent]) >= 0) {
+			break;
+		}
+		__sb_heap_set(heap, index, heap->entries[parent], heap->handles[parent]);
+		index = parent;
+	}
+	__sb_heap_set(heap, index, value, handle);
+	return index;
+}
+
+/**
+ * Moves the entry at the given position towards the bottom until it goes
+ * before all of its children. This function is not designed to be called by
+ * the end user.
+ */
+__songbird_header__
+void __sb_heap_down(sb_heap_t *heap, unsigned index) {
+	void const *value = heap->entries[index];
+	unsigned handle = heap->handles[index];
+	unsigned first, last, child, best;
+	for(;;) {
+		/* the parent of the last entry is the last one with children */
+		if(heap->size <= 1 || index > (heap->size - 2) / SB_HEAP_ARITY) {
+			break;
+		}
+		first = index * SB_HEAP_ARITY + 1;
+		last = first + SB_HEAP_ARITY < heap->size
+			? first + SB_HEAP_ARITY : heap->size;
+		best = first;
+		for(child = first + 1; child < last; ++child) {
+			if(heap->compare(heap->context, heap->entries[child],
+						heap->entries[best]) < 0) {
+				best = child;
+			}
+		}
+		if(heap->compare(heap->context, heap->entries[best], value) >= 0) {
+			break;
+		}
+		__sb_heap_set(heap, index, heap->entries[best], heap->handles[best]);
+		index = best;
+	}
+	__sb_heap_set(heap, index, value, handle);
+}
+
+__songbird_header__
+unsigned sb_heap_push(sb_heap_t *heap, void const *value) {
+	unsigned handle;
+	if(heap->size >= heap->capacity && __sb_heap_grow(heap, 1)) {
+		return SB_HEAP_INVALID;
+	}
+	handle = __sb_heap_handle(heap, heap->size);
+	__sb_heap_set(heap, heap->size, value, handle);
+	++*(unsigned *)&heap->size;
+	__sb_heap_up(heap, heap->size - 1);
+	return handle;
+}
+
+__songbird_header__
+int sb_heap_push_array(sb_heap_t *heap, void const **values, unsigned count,
+		unsigned *handles) {
+	unsigned i, handle;
+	if(count == 0) {
+		return 0;
+	}
+	if(__sb_heap_grow(heap, count)) {
+		return -1;
+	}
+	for(i = 0; i < count; ++i) {
+		handle = __sb_heap_handle(heap, heap->size);
+		__sb_heap_set(heap, heap->size, values[i], handle);
+		++*(unsigned *)&heap->size;
+		if(handles != NULL) {
+			handles[i] = handle;
+		}
+	}
+	if(heap->size < 2) {
+		return 0;
+	}
+	/* every parent from the bottom up, most of the work is near the leaves */
+	for(i = (heap->size - 2) / SB_HEAP_ARITY + 1; i-- > 0;) {
+		__sb_heap_down(heap, i);
+	}
+	return 0;
+}
+
+__songbird_header__
+void const *sb_heap_peek(sb_heap_t *heap) {
+	return heap->size ? heap->entries[0] : NULL;
+}
+
+__songbird_header__
+void const *sb_heap_pop(sb_heap_t *heap) {
+	if(heap->size == 0) {
+		return NULL;
+	}
+	return sb_heap_remove(heap, heap->handles[0]);
+}
+
+__songbird_header__
+void const *sb_heap_get(sb_heap_t *heap, unsigned handle) {
+	return heap->entries[heap->positions[handle]];
+}
+
+__songbird_header__
+void sb_heap_update(sb_heap_t *heap, unsigned handle, void const *value) {
+	unsigned index = heap->positions[handle];
+	heap->entries[index] = value;
+	if(__sb_heap_up(heap, index) == index) {
+		__sb_heap_down(heap, index);
+	}
+}
+
+__songbird_header__
+void const *sb_heap_remove(sb_heap_t *heap, unsigned handle) {
+	unsigned index = heap->positions[handle];
+	void const *value = heap->entries[index];
+	unsigned last = heap->size - 1;
+	--*(unsigned *)&heap->size;
+	heap->positions[handle] = heap->free_handle;
+	heap->free_handle = handle;
+	if(index == last) {
+		return value;
+	}
+	/* the last entry fills the hole and moves whichever way it belongs */
+	__sb_heap_set(heap, index, heap->entries[last], heap->handles[last]);
+	if(__sb_heap_up(heap, index) == index) {
+		__sb_heap_down(heap, index);
+	}
+	return value;
+}
+
+/*
+ * These are only available when vector.h is included before this file.
+ */
+#ifdef __SONGBIRD_VECTOR_H__
+/**
+ * Pushes all values of the given vector onto the heap at once, in linear
+ * time, the vector is not changed. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails, in which case
+ * nothing is pushed.
+ * @param heap The heap.
+ * @param vector The vector.
+ * @param handles Where to store the handle of every value, in the order of
+ * 		the vector, or NULL.
+ * @return 0 on success, -1 on failure.
+ */
+__songbird_header__
+int sb_heap_push_vector(sb_heap_t *heap, sb_vector_t *vector,
+		unsigned *handles) {
+	return sb_heap_push_array(heap, vector->entries, vector->size, handles);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef __songbird_header__
+
+#endif /* __SONGBIRD_HEAP_H__ */
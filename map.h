@@ -0,0 +1,799 @@
+/**
+ * Copyright (c) 2014-2017 Robert Maupin <chasesan@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SONGBIRD_MAP_H__
+#define __SONGBIRD_MAP_H__
+
+#ifndef __SB_NO_ALLOC__
+#include <stdlib.h>
+#define sb_malloc malloc
+#define sb_realloc realloc
+#define sb_free free
+#endif /* __SB_NO_ALLOC__ */
+
+#ifndef __SB_ALLOCATOR__
+#define __SB_ALLOCATOR__
+#include <stddef.h>
+/*
+ * A runtime allocator, handed to a container when it is initialized. A NULL
+ * allocator stands for sb_malloc, sb_realloc and sb_free. The allocator has
+ * to outlive every container using it and release has to accept NULL.
+ * alloc.h provides arena and pool allocators.
+ */
+typedef struct sb_allocator {
+	void *(*alloc)(void *context, size_t size);
+	void *(*resize)(void *context, void *ptr, size_t size);
+	void (*release)(void *context, void *ptr);
+	void *context;
+} sb_allocator_t;
+#define __sb_allocate(a, size) \
+	((a) ? (a)->alloc((a)->context, (size)) : sb_malloc(size))
+#define __sb_reallocate(a, ptr, size) \
+	((a) ? (a)->resize((a)->context, (ptr), (size)) : sb_realloc((ptr), (size)))
+#define __sb_deallocate(a, ptr) \
+	((a) ? (a)->release((a)->context, (ptr)) : sb_free(ptr))
+#endif
+
+#include <string.h>
+
+#ifdef __cplusplus
+/* Not sure why you would want to use this in C++, but just in case. */
+extern "C" {
+#define __songbird_map__	inline
+/* Works even if __STDC_VERSION__ is not defined. */
+#elif __STDC_VERSION__ <= 199409L
+#define __songbird_map__	static __inline__
+#else
+#define __songbird_map__	static inline
+#endif
+
+#ifndef __SB_ERROR__
+#define __SB_ERROR__
+enum {
+	SB_ERROR_NONE = 0,
+	SB_ERROR_MEMORY_ALLOCATION = 1,
+	SB_ERROR_OUT_OF_BOUNDS = 2,
+};
+#if __STDC_VERSION__ >= 201112L && !defined __STDC_NO_THREADS__
+__thread int sb_error = SB_ERROR_NONE;
+#else
+int sb_error = SB_ERROR_NONE;
+#endif
+#define sb_error() (sb_error)
+#define sb_error_clear() (sb_error = SB_ERROR_NONE)
+#endif
+
+/*
+ * Open addressing hash maps with Robin Hood probing. A key that has moved
+ * further from its home slot takes the place of one that has moved less,
+ * which keeps every probe sequence short even when the table is 7/8 full,
+ * and removal shifts the following keys back instead of leaving
+ * tombstones. The whole table is one allocation, lookups walk it linearly.
+ */
+
+enum {
+	SB_MAP_DEFAULT_CAPACITY = 16
+};
+
+/** hashes a key, equal keys must hash equally */
+typedef unsigned (*sb_hash_f)(void const *key);
+/** returns non-zero if the keys are equal */
+typedef int (*sb_equal_f)(void const *a, void const *b);
+/** gets the context, a key and its value, non-zero stops the iteration */
+typedef int (*sb_map_each_f)(void *context, void const *key, void const *value);
+
+struct __sb_map_slot {
+	void const *key;
+	void const *value;
+	unsigned hash;
+	/* 0 for an empty slot, otherwise one more than the distance from home */
+	unsigned distance;
+};
+
+/**
+ * @brief The map structure.
+ * This is the structure used by the sb_map_* functions. Keys and values
+ * are pointers, what they point at is not copied.
+ * It is highly recommended you do not change any values in this
+ * structure manually.
+ */
+typedef struct sb_map {
+	unsigned const size;
+	unsigned const capacity;
+	struct __sb_map_slot *slots;
+	sb_hash_f hash;
+	sb_equal_f equal;
+	sb_allocator_t const *allocator;
+} sb_map_t;
+
+/**
+ * Initializes the specified map. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
+ * @param map The map to initialize.
+ * @param hash The hash function, if NULL keys are compared as pointers.
+ * @param equal The equality function, if NULL keys are compared as pointers.
+ */
+__songbird_map__
+void sb_map_init(sb_map_t *map, sb_hash_f hash, sb_equal_f equal);
+
+/**
+ * Initializes the specified map with room for the given number of keys,
+ * taking its memory from the given allocator. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
+ * @param map The map to initialize.
+ * @param count The number of keys the map holds without growing.
+ * @param hash The hash function, if NULL keys are compared as pointers.
+ * @param equal The equality function, if NULL keys are compared as pointers.
+ * @param allocator The allocator, or NULL for sb_malloc.
+ */
+__songbird_map__
+void sb_map_init_alloc(sb_map_t *map, unsigned count, sb_hash_f hash,
+	sb_equal_f equal, sb_allocator_t const *allocator);
+
+/**
+ * Frees all allocated memory for the given map.
+ * @param map The map to free.
+ */
+__songbird_map__
+void sb_map_free(sb_map_t *map);
+
+/**
+ * Determines the size of the given map.
+ * @param map The map.
+ * @return The current number of keys in the map.
+ */
+__songbird_map__
+unsigned sb_map_size(sb_map_t *map);
+
+/**
+ * Makes room for the given number of keys, so that many can be put without
+ * the map growing. sb_error is set to SB_ERROR_MEMORY_ALLOCATION if the
+ * memory allocation fails.
+ * @param map The map.
+ * @param count The number of keys.
+ */
+__songbird_map__
+void sb_map_reserve(sb_map_t *map, unsigned count);
+
+/**
+ * Looks up the value of the given key.
+ * @param map The map.
+ * @param key The key.
+ * @return The value, or NULL if the key is not in the map.
+ */
+__songbird_map__
+void const *sb_map_get(sb_map_t *map, void const *key);
+
+/**
+ * Determines if the given key is in the map, for maps that store NULL
+ * values.
+ * @param map The map.
+ * @param key The key.
+ * @return 1 if the key is in the map, 0 if not.
+ */
+__songbird_map__
+int sb_map_has(sb_map_t *map, void const *key);
+
+/**
+ * Puts a key and its value into the map, replacing the value if the key is
+ * already there, in which case the map keeps the key it had. sb_error is set
+ * to SB_ERROR_MEMORY_ALLOCATION if the memory allocation during expansion
+ * fails.
+ * @param map The map.
+ * @param key The key.
+ * @param value The value.
+ * @return The value previously stored for the key, or NULL if there was
+ * 		none.
+ */
+__songbird_map__
+void const *sb_map_put(sb_map_t *map, void const *key, void const *value);
+
+/**
+ * Removes the given key from the map.
+ * @param map The map.
+ * @param key The key.
+ * @return The value stored for the key, or NULL if it was not in the map.
+ */
+__songbird_map__
+void const *sb_map_remove(sb_map_t *map, void const *key);
+
+/**
+ * Steps through the map. Start with the cursor at 0, every call stores the
+ * next key and value and moves the cursor on. The map must not change in
+ * between, except for sb_map_put on keys already in it.
+ * @param map The map.
+ * @param cursor The position, 0 to start.
+ * @param key Where to store the key.
+ * @param value Where to store the value.
+ * @return 1 if a key was stored, 0 at the end of the map.
+ */
+__songbird_map__
+int sb_map_next(sb_map_t *map, unsigned *cursor, void const **key,
+	void const **value);
+
+/**
+ * Iterates through the given map calling the specified function with the
+ * context and every key and value, in no particular order, until it
+ * returns non-zero.
+ * @param map The map.
+ * @param each The function to call, it must not be NULL.
+ * @param context Passed to each.
+ * @return What each returned if it was non-zero, otherwise 0.
+ */
+__songbird_map__
+int sb_map_each(sb_map_t *map, sb_map_each_f each, void *context);
+
+/** hashes a nul terminated string, for maps keyed by strings */
+__songbird_map__
+unsigned sb_map_hash_string(void const *key);
+
+/** compares nul terminated strings, for maps keyed by strings */
+__songbird_map__
+int sb_map_equal_string(void const *a, void const *b);
+
+/** hashes the bytes of a key, for use by the hash functions of SB_MAP_DECLARE */
+__songbird_map__
+unsigned sb_map_hash_bytes(void const *key, size_t size);
+
+/* function definitions */
+
+/**
+ * Spreads the bits of a hash so that the low bits, which pick the slot,
+ * depend on all of them. This function is not designed to be called by the
+ * end user.
+ */
+__songbird_map__
+unsigned __sb_map_mix(unsigned hash) {
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3bu;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+/**
+ * Works out the number of slots needed to hold count keys at the maximum
+ * load of 7/8, or 0 if that many do not fit. This function is not designed
+ * to be called by the end user.
+ */
+__songbird_map__
+unsigned __sb_map_capacity(unsigned count) {
+	unsigned capacity = SB_MAP_DEFAULT_CAPACITY;
+	while(capacity - capacity / 8 < count) {
+		if(capacity * 2 < capacity) {
+			return 0;
+		}
+		capacity *= 2;
+	}
+	return capacity;
+}
+
+__songbird_map__
+unsigned sb_map_hash_bytes(void const *key, size_t size) {
+	/* FNV-1a */
+	unsigned char const *bytes = (unsigned char const *)key;
+	unsigned hash = 2166136261u;
+	size_t i;
+	for(i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+__songbird_map__
+unsigned sb_map_hash_string(void const *key) {
+	return sb_map_hash_bytes(key, strlen((char const *)key));
+}
+
+__songbird_map__
+int sb_map_equal_string(void const *a, void const *b) {
+	return strcmp((char const *)a, (char const *)b) == 0;
+}
+
+__songbird_map__
+unsigned __sb_map_hash_pointer(void const *key) {
+	size_t bits = (size_t)key;
+	/* the low bits are mostly alignment */
+	return (unsigned)(bits >> 4) ^ (unsigned)(bits >> 4 >> 16 >> 16);
+}
+
+__songbird_map__
+int __sb_map_equal_pointer(void const *a, void const *b) {
+	return a == b;
+}
+
+__songbird_map__
+void sb_map_init(sb_map_t *map, sb_hash_f hash, sb_equal_f equal) {
+	sb_map_init_alloc(map, 0, hash, equal, NULL);
+}
+
+__songbird_map__
+void sb_map_init_alloc(sb_map_t *map, unsigned count, sb_hash_f hash,
+		sb_equal_f equal, sb_allocator_t const *allocator) {
+	unsigned capacity = __sb_map_capacity(count);
+	*(unsigned *)&map->size = 0;
+	*(unsigned *)&map->capacity = 0;
+	map->hash = hash ? hash : __sb_map_hash_pointer;
+	map->equal = equal ? equal : __sb_map_equal_pointer;
+	map->allocator = allocator;
+	map->slots = NULL;
+	if(capacity != 0) {
+		map->slots = (struct __sb_map_slot *)__sb_allocate(allocator,
+				sizeof(struct __sb_map_slot) * capacity);
+	}
+	if(map->slots == NULL) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return;
+	}
+	memset(map->slots, 0, sizeof(struct __sb_map_slot) * capacity);
+	*(unsigned *)&map->capacity = capacity;
+}
+
+__songbird_map__
+void sb_map_free(sb_map_t *map) {
+	if(!map) {
+		return;
+	}
+	__sb_deallocate(map->allocator, map->slots);
+	map->slots = NULL;
+	*(unsigned *)&map->size = 0;
+	*(unsigned *)&map->capacity = 0;
+}
+
+__songbird_map__
+unsigned sb_map_size(sb_map_t *map) {
+	return map->size;
+}
+
+/**
+ * Places a key that is known not to be in the map. This function is not
+ * designed to be called by the end user.
+ */
+__songbird_map__
+void __sb_map_place(sb_map_t *map, struct __sb_map_slot entry) {
+	unsigned mask = map->capacity - 1;
+	unsigned index = __sb_map_mix(entry.hash) & mask;
+	struct __sb_map_slot swap;
+	entry.distance = 1;
+	for(;;) {
+		struct __sb_map_slot *slot = &map->slots[index];
+		if(slot->distance == 0) {
+			*slot = entry;
+			++*(unsigned *)&map->size;
+			return;
+		}
+		if(slot->distance < entry.distance) {
+			/* take from the rich, the displaced key carries on */
+			swap = *slot;
+			*slot = entry;
+			entry = swap;
+		}
+		index = (index + 1) & mask;
+		++entry.distance;
+	}
+}
+
+/**
+ * Moves all keys into a table with room for count keys. This function is
+ * not designed to be called by the end user.
+ * @return 0 on success, -1 on failure, the map is left as it was.
+ */
+__songbird_map__
+int __sb_map_rehash(sb_map_t *map, unsigned count) {
+	unsigned capacity = __sb_map_capacity(count);
+	struct __sb_map_slot *old = map->slots;
+	unsigned old_capacity = map->capacity;
+	unsigned i;
+	if(capacity == 0) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return -1;
+	}
+	if(capacity <= old_capacity) {
+		return 0;
+	}
+	map->slots = (struct __sb_map_slot *)__sb_allocate(map->allocator,
+			sizeof(struct __sb_map_slot) * capacity);
+	if(map->slots == NULL) {
+		map->slots = old;
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return -1;
+	}
+	memset(map->slots, 0, sizeof(struct __sb_map_slot) * capacity);
+	*(unsigned *)&map->capacity = capacity;
+	*(unsigned *)&map->size = 0;
+	for(i = 0; i < old_capacity; ++i) {
+		if(old[i].distance != 0) {
+			__sb_map_place(map, old[i]);
+		}
+	}
+	__sb_deallocate(map->allocator, old);
+	return 0;
+}
+
+__songbird_map__
+void sb_map_reserve(sb_map_t *map, unsigned count) {
+	__sb_map_rehash(map, count);
+}
+
+/**
+ * Finds the slot of the given key. This function is not designed to be
+ * called by the end user.
+ * @return The index of the slot, or -1 if the key is not in the map.
+ */
+__songbird_map__
+long __sb_map_find(sb_map_t *map, void const *key, unsigned hash) {
+	unsigned mask = map->capacity - 1;
+	unsigned index = __sb_map_mix(hash) & mask;
+	unsigned distance = 1;
+	struct __sb_map_slot *slot;
+	if(map->capacity == 0) {
+		return -1;
+	}
+	for(;;) {
+		slot = &map->slots[index];
+		/* a key this far from home would have taken this slot */
+		if(slot->distance < distance) {
+			return -1;
+		}
+		if(slot->hash == hash && map->equal(slot->key, key)) {
+			return (long)index;
+		}
+		index = (index + 1) & mask;
+		++distance;
+	}
+}
+
+__songbird_map__
+void const *sb_map_get(sb_map_t *map, void const *key) {
+	long index = __sb_map_find(map, key, map->hash(key));
+	return index < 0 ? NULL : map->slots[index].value;
+}
+
+__songbird_map__
+int sb_map_has(sb_map_t *map, void const *key) {
+	return __sb_map_find(map, key, map->hash(key)) >= 0;
+}
+
+__songbird_map__
+void const *sb_map_put(sb_map_t *map, void const *key, void const *value) {
+	struct __sb_map_slot entry;
+	void const *previous;
+	long index;
+	entry.hash = map->hash(key);
+	index = __sb_map_find(map, key, entry.hash);
+	if(index >= 0) {
+		previous = map->slots[index].value;
+		map->slots[index].value = value;
+		return previous;
+	}
+	if(map->size >= map->capacity - map->capacity / 8
+			&& __sb_map_rehash(map, map->size + 1)) {
+		return NULL;
+	}
+	entry.key = key;
+	entry.value = value;
+	__sb_map_place(map, entry);
+	return NULL;
+}
+
+__songbird_map__
+void const *sb_map_remove(sb_map_t *map, void const *key) {
+	unsigned mask = map->capacity - 1;
+	long found = __sb_map_find(map, key, map->hash(key));
+	unsigned index, next;
+	void const *value;
+	if(found < 0) {
+		return NULL;
+	}
+	index = (unsigned)found;
+	value = map->slots[index].value;
+	/* shift the keys after it back a slot, until one is at home */
+	for(;;) {
+		next = (index + 1) & mask;
+		if(map->slots[next].distance <= 1) {
+			break;
+		}
+		map->slots[index] = map->slots[next];
+		--map->slots[index].distance;
+		index = next;
+	}
+	map->slots[index].distance = 0;
+	--*(unsigned *)&map->size;
+	return value;
+}
+
+__songbird_map__
+int sb_map_next(sb_map_t *map, unsigned *cursor, void const **key,
+		void const **value) {
+	for(; *cursor < map->capacity; ++*cursor) {
+		if(map->slots[*cursor].distance != 0) {
+			*key = map->slots[*cursor].key;
+			*value = map->slots[*cursor].value;
+			++*cursor;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+__songbird_map__
+int sb_map_each(sb_map_t *map, sb_map_each_f each, void *context) {
+	unsigned i;
+	int result;
+	for(i = 0; i < map->capacity; ++i) {
+		if(map->slots[i].distance != 0) {
+			result = each(context, map->slots[i].key, map->slots[i].value);
+			if(result) {
+				return result;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * Declares a map that stores keys of type K and values of type V inline in
+ * its table, without the extra allocations and pointers of a sb_map_t. It
+ * produces the type name##_t and the functions below, which behave like
+ * their sb_map_* counterparts. hash and equal are the names of functions
+ *
+ *   unsigned hash(K const *key);
+ *   int equal(K const *a, K const *b);
+ *
+ * which the compiler can inline, sb_map_hash_bytes helps with plain keys.
+ * The same declaration must not be repeated in one translation unit.
+ *
+ *   void name##_init(name##_t *map);
+ *   void name##_init_alloc(name##_t *map, unsigned count,
+ *   		sb_allocator_t const *allocator);
+ *   void name##_free(name##_t *map);
+ *   unsigned name##_size(name##_t *map);
+ *   void name##_reserve(name##_t *map, unsigned count);
+ *   V *name##_get(name##_t *map, K const *key);
+ *   V *name##_put(name##_t *map, K key, V value);
+ *   int name##_remove(name##_t *map, K const *key, V *removed);
+ *   int name##_next(name##_t *map, unsigned *cursor, K **key, V **value);
+ *
+ * name##_get returns a pointer into the table, or NULL if the key is not
+ * there, and name##_put returns where the value was stored, or NULL if the
+ * map could not grow. Both stay valid until the map next changes.
+ * name##_remove returns 1 and copies the value into removed unless it is
+ * NULL, or returns 0 if the key was not there.
+ */
+#define SB_MAP_DECLARE(name, K, V, hash, equal) \
+struct name##_slot { \
+	K key; \
+	V value; \
+	unsigned hash; \
+	unsigned distance; \
+}; \
+\
+typedef struct name { \
+	unsigned const size; \
+	unsigned const capacity; \
+	struct name##_slot *slots; \
+	sb_allocator_t const *allocator; \
+} name##_t; \
+\
+__songbird_map__ \
+void name##_init_alloc(name##_t *map, unsigned count, \
+		sb_allocator_t const *allocator) { \
+	unsigned capacity = __sb_map_capacity(count); \
+	*(unsigned *)&map->size = 0; \
+	*(unsigned *)&map->capacity = 0; \
+	map->allocator = allocator; \
+	map->slots = NULL; \
+	if(capacity != 0) { \
+		map->slots = (struct name##_slot *)__sb_allocate(allocator, \
+				sizeof(struct name##_slot) * capacity); \
+	} \
+	if(map->slots == NULL) { \
+		sb_error = SB_ERROR_MEMORY_ALLOCATION; \
+		return; \
+	} \
+	memset(map->slots, 0, sizeof(struct name##_slot) * capacity); \
+	*(unsigned *)&map->capacity = capacity; \
+} \
+\
+__songbird_map__ \
+void name##_init(name##_t *map) { \
+	name##_init_alloc(map, 0, NULL); \
+} \
+\
+__songbird_map__ \
+void name##_free(name##_t *map) { \
+	if(!map) { \
+		return; \
+	} \
+	__sb_deallocate(map->allocator, map->slots); \
+	map->slots = NULL; \
+	*(unsigned *)&map->size = 0; \
+	*(unsigned *)&map->capacity = 0; \
+} \
+\
+__songbird_map__ \
+unsigned name##_size(name##_t *map) { \
+	return map->size; \
+} \
+\
+__songbird_map__ \
+struct name##_slot *__##name##_place(name##_t *map, \
+		struct name##_slot entry) { \
+	unsigned mask = map->capacity - 1; \
+	unsigned index = __sb_map_mix(entry.hash) & mask; \
+	struct name##_slot *placed = NULL; \
+	struct name##_slot swap; \
+	entry.distance = 1; \
+	for(;;) { \
+		struct name##_slot *slot = &map->slots[index]; \
+		if(slot->distance == 0) { \
+			*slot = entry; \
+			++*(unsigned *)&map->size; \
+			return placed ? placed : slot; \
+		} \
+		if(slot->distance < entry.distance) { \
+			swap = *slot; \
+			*slot = entry; \
+			entry = swap; \
+			if(placed == NULL) { \
+				placed = slot; \
+			} \
+		} \
+		index = (index + 1) & mask; \
+		++entry.distance; \
+	} \
+} \
+\
+__songbird_map__ \
+int __##name##_rehash(name##_t *map, unsigned count) { \
+	unsigned capacity = __sb_map_capacity(count); \
+	struct name##_slot *old = map->slots; \
+	unsigned old_capacity = map->capacity; \
+	unsigned i; \
+	if(capacity == 0) { \
+		sb_error = SB_ERROR_MEMORY_ALLOCATION; \
+		return -1; \
+	} \
+	if(capacity <= old_capacity) { \
+		return 0; \
+	} \
+	map->slots = (struct name##_slot *)__sb_allocate(map->allocator, \
+			sizeof(struct name##_slot) * capacity); \
+	if(map->slots == NULL) { \
+		map->slots = old; \
+		sb_error = SB_ERROR_MEMORY_ALLOCATION; \
+		return -1; \
+	} \
+	memset(map->slots, 0, sizeof(struct name##_slot) * capacity); \
+	*(unsigned *)&map->capacity = capacity; \
+	*(unsigned *)&map->size = 0; \
+	for(i = 0; i < old_capacity; ++i) { \
+		if(old[i].distance != 0) { \
+			__##name##_place(map, old[i]); \
+		} \
+	} \
+	__sb_deallocate(map->allocator, old); \
+	return 0; \
+} \
+\
+__songbird_map__ \
+void name##_reserve(name##_t *map, unsigned count) { \
+	__##name##_rehash(map, count); \
+} \
+\
+__songbird_map__ \
+struct name##_slot *__##name##_find(name##_t *map, K const *key, \
+		unsigned hashed) { \
+	unsigned mask = map->capacity - 1; \
+	unsigned index = __sb_map_mix(hashed) & mask; \
+	unsigned distance = 1; \
+	struct name##_slot *slot; \
+	if(map->capacity == 0) { \
+		return NULL; \
+	} \
+	for(;;) { \
+		slot = &map->slots[index]; \
+		if(slot->distance < distance) { \
+			return NULL; \
+		} \
+		if(slot->hash == hashed && equal(&slot->key, key)) { \
+			return slot; \
+		} \
+		index = (index + 1) & mask; \
+		++distance; \
+	} \
+} \
+\
+__songbird_map__ \
+V *name##_get(name##_t *map, K const *key) { \
+	struct name##_slot *slot = __##name##_find(map, key, hash(key)); \
+	return slot ? &slot->value : NULL; \
+} \
+\
+__songbird_map__ \
+V *name##_put(name##_t *map, K key, V value) { \
+	struct name##_slot entry; \
+	struct name##_slot *slot; \
+	entry.hash = hash(&key); \
+	slot = __##name##_find(map, &key, entry.hash); \
+	if(slot != NULL) { \
+		slot->value = value; \
+		return &slot->value; \
+	} \
+	if(map->size >= map->capacity - map->capacity / 8 \
+			&& __##name##_rehash(map, map->size + 1)) { \
+		return NULL; \
+	} \
+	entry.key = key; \
+	entry.value = value; \
+	return &__##name##_place(map, entry)->value; \
+} \
+\
+__songbird_map__ \
+int name##_remove(name##_t *map, K const *key, V *removed) { \
+	unsigned mask = map->capacity - 1; \
+	struct name##_slot *slot = __##name##_find(map, key, hash(key)); \
+	unsigned index, next; \
+	if(slot == NULL) { \
+		return 0; \
+	} \
+	if(removed != NULL) { \
+		*removed = slot->value; \
+	} \
+	index = (unsigned)(slot - map->slots); \
+	for(;;) { \
+		next = (index + 1) & mask; \
+		if(map->slots[next].distance <= 1) { \
+			break; \
+		} \
+		map->slots[index] = map->slots[next]; \
+		--map->slots[index].distance; \
+		index = next; \
+	} \
+	map->slots[index].distance = 0; \
+	--*(unsigned *)&map->size; \
+	return 1; \
+} \
+\
+__songbird_map__ \
+int name##_next(name##_t *map, unsigned *cursor, K **key, V **value) { \
+	for(; *cursor < map->capacity; ++*cursor) { \
+		if(map->slots[*cursor].distance != 0) { \
+			*key = &map->slots[*cursor].key; \
+			*value = &map->slots[*cursor].value; \
+			++*cursor; \
+			return 1; \
+		} \
+	} \
+	return 0; \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * __songbird_map__ stays defined, the functions SB_MAP_DECLARE produces are
+ * expanded after this point.
+ */
+
+#endif /* __SONGBIRD_MAP_H__ */
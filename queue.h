@@ -0,0 +1,835 @@
+/**
+ * Copyright (c) 2014-2017 Robert Maupin <chasesan@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SONGBIRD_QUEUE_H__
+#define __SONGBIRD_QUEUE_H__
+
+/*
+ * Strict C modes hide the POSIX and BSD functions used below. This asks for
+ * them, but only works if no system header was included before this file,
+ * otherwise compile with _DEFAULT_SOURCE defined.
+ */
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE) && !defined(_GNU_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#ifndef __SB_NO_ALLOC__
+#include <stdlib.h>
+#define sb_malloc malloc
+#define sb_realloc realloc
+#define sb_free free
+#endif /* __SB_NO_ALLOC__ */
+
+#ifndef __SB_ALLOCATOR__
+#define __SB_ALLOCATOR__
+#include <stddef.h>
+/*
+ * A runtime allocator, handed to a container when it is initialized. A NULL
+ * allocator stands for sb_malloc, sb_realloc and sb_free. The allocator has
+ * to outlive every container using it and release has to accept NULL.
+ * alloc.h provides arena and pool allocators.
+ */
+typedef struct sb_allocator {
+	void *(*alloc)(void *context, size_t size);
+	void *(*resize)(void *context, void *ptr, size_t size);
+	void (*release)(void *context, void *ptr);
+	void *context;
+} sb_allocator_t;
+#define __sb_allocate(a, size) \
+	((a) ? (a)->alloc((a)->context, (size)) : sb_malloc(size))
+#define __sb_reallocate(a, ptr, size) \
+	((a) ? (a)->resize((a)->context, (ptr), (size)) : sb_realloc((ptr), (size)))
+#define __sb_deallocate(a, ptr) \
+	((a) ? (a)->release((a)->context, (ptr)) : sb_free(ptr))
+#endif
+
+#include <string.h>
+#include <limits.h>
+
+/* blocking waits sleep on a futex on Linux and yield elsewhere */
+#if defined(__linux__)
+#define __SB_QUEUE_FUTEX__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+#ifdef __cplusplus
+/* Not sure why you would want to use this in C++, but just in case. */
+extern "C" {
+#define __songbird_header__	inline
+/* Works even if __STDC_VERSION__ is not defined. */
+#elif __STDC_VERSION__ <= 199409L
+#define __songbird_header__	static __inline__
+#else
+#define __songbird_header__	static inline
+#endif
+
+#ifndef __SB_ERROR__
+#define __SB_ERROR__
+enum {
+	SB_ERROR_NONE = 0,
+	SB_ERROR_MEMORY_ALLOCATION = 1,
+	SB_ERROR_OUT_OF_BOUNDS = 2,
+};
+#if __STDC_VERSION__ >= 201112L && !defined __STDC_NO_THREADS__
+__thread int sb_error = SB_ERROR_NONE;
+#else
+int sb_error = SB_ERROR_NONE;
+#endif
+#define sb_error() (sb_error)
+#define sb_error_clear() (sb_error = SB_ERROR_NONE)
+#endif
+
+#ifndef __SB_ATOMIC__
+#define __SB_ATOMIC__
+/*
+ * The C11 memory model on plain integers and pointers. GCC and Clang provide
+ * it in any language mode, other compilers need C11 atomics.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define __sb_atomic_t(T) T
+#define __sb_atomic_load(p, o) __atomic_load_n((p), __ATOMIC_##o)
+#define __sb_atomic_store(p, v, o) __atomic_store_n((p), (v), __ATOMIC_##o)
+#define __sb_atomic_add(p, v, o) __atomic_fetch_add((p), (v), __ATOMIC_##o)
+#define __sb_atomic_cas(p, e, d, o) \
+	__atomic_compare_exchange_n((p), (e), (d), 0, __ATOMIC_##o, __ATOMIC_RELAXED)
+#define __sb_atomic_fence(o) __atomic_thread_fence(__ATOMIC_##o)
+#elif __STDC_VERSION__ >= 201112L && !defined __STDC_NO_ATOMICS__
+#include <stdatomic.h>
+#define __SB_MO_RELAXED memory_order_relaxed
+#define __SB_MO_ACQUIRE memory_order_acquire
+#define __SB_MO_RELEASE memory_order_release
+#define __SB_MO_ACQ_REL memory_order_acq_rel
+#define __SB_MO_SEQ_CST memory_order_seq_cst
+#define __sb_atomic_t(T) _Atomic T
+#define __sb_atomic_load(p, o) atomic_load_explicit((p), __SB_MO_##o)
+#define __sb_atomic_store(p, v, o) atomic_store_explicit((p), (v), __SB_MO_##o)
+#define __sb_atomic_add(p, v, o) atomic_fetch_add_explicit((p), (v), __SB_MO_##o)
+#define __sb_atomic_cas(p, e, d, o) atomic_compare_exchange_strong_explicit( \
+	(p), (e), (d), __SB_MO_##o, memory_order_relaxed)
+#define __sb_atomic_fence(o) atomic_thread_fence(__SB_MO_##o)
+#else
+#error "Songbird needs GCC/Clang atomic builtins or C11 atomics."
+#endif
+enum {
+	/* fields written by different threads are kept this far apart */
+	SB_CACHE_LINE = 64
+};
+#endif
+
+enum {
+	SB_QUEUE_DEFAULT_CAPACITY = 1024,
+	/* attempts a blocking call makes before it goes to sleep */
+	SB_QUEUE_SPIN = 128,
+	/* longest sleep in milliseconds before a blocking call looks again */
+	SB_QUEUE_SLEEP = 100
+};
+
+/*
+ * A bounded single producer, single consumer queue. It is the ring of
+ * sb_deque_t with the front and back indices owned by one thread each, so
+ * pushing and popping need no lock, only an acquire load and a release
+ * store. Each side also caches the index of the other side and only reloads
+ * it when the ring looks full or empty, keeping the cache lines of the two
+ * threads apart.
+ */
+
+/**
+ * @brief The single producer, single consumer queue structure.
+ * This is the structure used by the sb_spsc_* functions.
+ * It is highly recommended you do not change any values in this
+ * structure manually.
+ */
+typedef struct sb_spsc {
+	/* never written after init */
+	unsigned const capacity;
+	void const **entries;
+	sb_allocator_t const *allocator;
+	char __pad0[SB_CACHE_LINE];
+	/* consumer side */
+	__sb_atomic_t(unsigned) front;
+	unsigned back_cache;
+	char __pad1[SB_CACHE_LINE - 2 * sizeof(unsigned)];
+	/* producer side */
+	__sb_atomic_t(unsigned) back;
+	unsigned front_cache;
+	char __pad2[SB_CACHE_LINE - 2 * sizeof(unsigned)];
+} sb_spsc_t;
+
+/**
+ * Initializes the specified queue. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
+ * @param queue The queue to initialize.
+ * @param capacity The number of values the queue can hold, if 0 it defaults
+ * 		to 1024 (the SB_QUEUE_DEFAULT_CAPACITY). It is rounded up to a power
+ * 		of two.
+ */
+__songbird_header__
+void sb_spsc_init(sb_spsc_t *queue, unsigned capacity);
+
+/**
+ * Initializes the specified queue, taking its memory from the given
+ * allocator. sb_error is set to SB_ERROR_MEMORY_ALLOCATION if the memory
+ * allocation fails.
+ * @param queue The queue to initialize.
+ * @param capacity The number of values the queue can hold, as for
+ * 		sb_spsc_init.
+ * @param allocator The allocator, or NULL for sb_malloc.
+ */
+__songbird_header__
+void sb_spsc_init_alloc(sb_spsc_t *queue, unsigned capacity,
+	sb_allocator_t const *allocator);
+
+/**
+ * Frees all allocated memory for the given queue. Neither thread may use
+ * the queue any more.
+ * @param queue The queue to free.
+ */
+__songbird_header__
+void sb_spsc_free(sb_spsc_t *queue);
+
+/**
+ * Determines the number of values in the queue. When called from a thread
+ * other than the consumer the result may already be out of date.
+ * @param queue The queue.
+ * @return The current number of values in the queue.
+ */
+__songbird_header__
+unsigned sb_spsc_size(sb_spsc_t *queue);
+
+/**
+ * Pushes the given value to the back of the queue. Only the producer thread
+ * may call this.
+ * @param queue The queue.
+ * @param value The value to push.
+ * @return 1 if the value was pushed, 0 if the queue is full.
+ */
+__songbird_header__
+int sb_spsc_push(sb_spsc_t *queue, void const *value);
+
+/**
+ * Pushes as many of the given values as fit to the back of the queue, in
+ * order, publishing them to the consumer at once. Only the producer thread
+ * may call this.
+ * @param queue The queue.
+ * @param values The values to push.
+ * @param count The number of values.
+ * @return The number of values pushed.
+ */
+__songbird_header__
+unsigned sb_spsc_push_many(sb_spsc_t *queue, void const **values,
+	unsigned count);
+
+/**
+ * Pops the value at the front of the queue. Only the consumer thread may
+ * call this.
+ * @param queue The queue.
+ * @return The value at the front of the queue, or NULL if it is empty.
+ */
+__songbird_header__
+void const *sb_spsc_pop(sb_spsc_t *queue);
+
+/**
+ * Pops up to max values from the front of the queue, in order, freeing
+ * their slots for the producer at once. Only the consumer thread may call
+ * this.
+ * @param queue The queue.
+ * @param values Where to store the values.
+ * @param max The maximum number of values to pop.
+ * @return The number of values popped.
+ */
+__songbird_header__
+unsigned sb_spsc_pop_many(sb_spsc_t *queue, void const **values,
+	unsigned max);
+
+/* function definitions */
+
+__songbird_header__
+void sb_spsc_init(sb_spsc_t *queue, unsigned capacity) {
+	sb_spsc_init_alloc(queue, capacity, NULL);
+}
+
+__songbird_header__
+void sb_spsc_init_alloc(sb_spsc_t *queue, unsigned capacity,
+		sb_allocator_t const *allocator) {
+	/* the indices wrap with a mask, so the capacity is a power of two */
+	unsigned n = SB_QUEUE_DEFAULT_CAPACITY;
+	if(capacity != 0) {
+		for(n = 1; n < capacity && n * 2 > n; n *= 2);
+	}
+	*(unsigned *)&queue->capacity = n;
+	queue->allocator = allocator;
+	queue->entries = (void const **)__sb_allocate(allocator, sizeof(void *) * n);
+	if(queue->entries == NULL) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+	}
+	queue->back_cache = 0;
+	queue->front_cache = 0;
+	__sb_atomic_store(&queue->front, 0, RELAXED);
+	__sb_atomic_store(&queue->back, 0, RELEASE);
+}
+
+__songbird_header__
+void sb_spsc_free(sb_spsc_t *queue) {
+	if(!queue) {
+		return;
+	}
+	__sb_deallocate(queue->allocator, (void *)queue->entries);
+	queue->entries = NULL;
+}
+
+__songbird_header__
+unsigned sb_spsc_size(sb_spsc_t *queue) {
+	unsigned front = __sb_atomic_load(&queue->front, ACQUIRE);
+	return __sb_atomic_load(&queue->back, ACQUIRE) - front;
+}
+
+/*
+ * The indices run freely and are masked on access, back - front is the
+ * number of values even after they wrap around.
+ */
+
+__songbird_header__
+unsigned sb_spsc_push_many(sb_spsc_t *queue, void const **values,
+		unsigned count) {
+	unsigned back = __sb_atomic_load(&queue->back, RELAXED);
+	unsigned mask = queue->capacity - 1;
+	unsigned space = queue->capacity - (back - queue->front_cache);
+	unsigned first;
+	if(space < count) {
+		queue->front_cache = __sb_atomic_load(&queue->front, ACQUIRE);
+		space = queue->capacity - (back - queue->front_cache);
+	}
+	if(count > space) {
+		count = space;
+	}
+	if(count == 0) {
+		return 0;
+	}
+	/* at most two copies, up to the end of the ring and from its start */
+	first = queue->capacity - (back & mask);
+	if(first > count) {
+		first = count;
+	}
+	memcpy(queue->entries + (back & mask), values, sizeof(void *) * first);
+	memcpy(queue->entries, values + first, sizeof(void *) * (count - first));
+	__sb_atomic_store(&queue->back, back + count, RELEASE);
+	return count;
+}
+
+__songbird_header__
+int sb_spsc_push(sb_spsc_t *queue, void const *value) {
+	unsigned back = __sb_atomic_load(&queue->back, RELAXED);
+	if(back - queue->front_cache == queue->capacity) {
+		queue->front_cache = __sb_atomic_load(&queue->front, ACQUIRE);
+		if(back - queue->front_cache == queue->capacity) {
+			return 0;
+		}
+	}
+	queue->entries[back & (queue->capacity - 1)] = value;
+	__sb_atomic_store(&queue->back, back + 1, RELEASE);
+	return 1;
+}
+
+__songbird_header__
+unsigned sb_spsc_pop_many(sb_spsc_t *queue, void const **values,
+		unsigned max) {
+	unsigned front = __sb_atomic_load(&queue->front, RELAXED);
+	unsigned mask = queue->capacity - 1;
+	unsigned count = queue->back_cache - front;
+	unsigned first;
+	if(count < max) {
+		queue->back_cache = __sb_atomic_load(&queue->back, ACQUIRE);
+		count = queue->back_cache - front;
+	}
+	if(count > max) {
+		count = max;
+	}
+	if(count == 0) {
+		return 0;
+	}
+	first = queue->capacity - (front & mask);
+	if(first > count) {
+		first = count;
+	}
+	memcpy(values, queue->entries + (front & mask), sizeof(void *) * first);
+	memcpy(values + first, queue->entries, sizeof(void *) * (count - first));
+	__sb_atomic_store(&queue->front, front + count, RELEASE);
+	return count;
+}
+
+__songbird_header__
+void const *sb_spsc_pop(sb_spsc_t *queue) {
+	unsigned front = __sb_atomic_load(&queue->front, RELAXED);
+	void const *value;
+	if(front == queue->back_cache) {
+		queue->back_cache = __sb_atomic_load(&queue->back, ACQUIRE);
+		if(front == queue->back_cache) {
+			return NULL;
+		}
+	}
+	value = queue->entries[front & (queue->capacity - 1)];
+	__sb_atomic_store(&queue->front, front + 1, RELEASE);
+	return value;
+}
+
+/*
+ * A bounded multi producer, multi consumer queue after Dmitry Vyukov. Every
+ * slot carries a sequence number that says whether it is free for the
+ * producer of a given position or holds the value for its consumer, so
+ * producers and consumers only compete on their own index with a single
+ * compare and swap and never take a lock.
+ */
+
+struct __sb_mpmc_slot {
+	__sb_atomic_t(unsigned) sequence;
+	void const *value;
+};
+
+/**
+ * @brief The multi producer, multi consumer queue structure.
+ * This is the structure used by the sb_mpmc_* functions.
+ * It is highly recommended you do not change any values in this
+ * structure manually.
+ */
+typedef struct sb_mpmc {
+	/* never written after init */
+	unsigned const capacity;
+	struct __sb_mpmc_slot *slots;
+	sb_allocator_t const *allocator;
+	char __pad0[SB_CACHE_LINE];
+	__sb_atomic_t(unsigned) back;
+	char __pad1[SB_CACHE_LINE - sizeof(unsigned)];
+	__sb_atomic_t(unsigned) front;
+	char __pad2[SB_CACHE_LINE - sizeof(unsigned)];
+	/* only touched once a blocking call has been made */
+	__sb_atomic_t(unsigned) blocking;
+	__sb_atomic_t(unsigned) pushed;
+	__sb_atomic_t(unsigned) popped;
+	__sb_atomic_t(unsigned) push_waiters;
+	__sb_atomic_t(unsigned) pop_waiters;
+	char __pad3[SB_CACHE_LINE - 5 * sizeof(unsigned)];
+} sb_mpmc_t;
+
+/**
+ * Initializes the specified queue. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
+ * @param queue The queue to initialize.
+ * @param capacity The number of values the queue can hold, if 0 it defaults
+ * 		to 1024 (the SB_QUEUE_DEFAULT_CAPACITY). It is rounded up to a power
+ * 		of two, at least 2.
+ */
+__songbird_header__
+void sb_mpmc_init(sb_mpmc_t *queue, unsigned capacity);
+
+/**
+ * Initializes the specified queue, taking its memory from the given
+ * allocator. sb_error is set to SB_ERROR_MEMORY_ALLOCATION if the memory
+ * allocation fails.
+ * @param queue The queue to initialize.
+ * @param capacity The number of values the queue can hold, as for
+ * 		sb_mpmc_init.
+ * @param allocator The allocator, or NULL for sb_malloc.
+ */
+__songbird_header__
+void sb_mpmc_init_alloc(sb_mpmc_t *queue, unsigned capacity,
+	sb_allocator_t const *allocator);
+
+/**
+ * Frees all allocated memory for the given queue. No thread may use or wait
+ * on the queue any more.
+ * @param queue The queue to free.
+ */
+__songbird_header__
+void sb_mpmc_free(sb_mpmc_t *queue);
+
+/**
+ * Determines the number of values in the queue. With other threads using
+ * the queue the result may already be out of date.
+ * @param queue The queue.
+ * @return The current number of values in the queue.
+ */
+__songbird_header__
+unsigned sb_mpmc_size(sb_mpmc_t *queue);
+
+/*
+ * Once a blocking call has been made on a queue, every successful push or
+ * pop, blocking or not, wakes the threads sleeping on the other side, so the
+ * try and blocking calls can be mixed freely. Until then the try calls skip
+ * the full fence that takes. A sleeper looks at the queue again after
+ * SB_QUEUE_SLEEP milliseconds in any case, which covers a try call that had
+ * not yet seen the first blocking call.
+ */
+
+/**
+ * Pushes the given value to the back of the queue if there is room.
+ * @param queue The queue.
+ * @param value The value to push.
+ * @return 1 if the value was pushed, 0 if the queue is full.
+ */
+__songbird_header__
+int sb_mpmc_try_push(sb_mpmc_t *queue, void const *value);
+
+/**
+ * Pops the value at the front of the queue if there is one.
+ * @param queue The queue.
+ * @param value Where to store the value.
+ * @return 1 if a value was popped, 0 if the queue is empty.
+ */
+__songbird_header__
+int sb_mpmc_try_pop(sb_mpmc_t *queue, void const **value);
+
+/**
+ * Pushes the given value to the back of the queue, waiting for room if it
+ * is full. The wait spins briefly and then sleeps until a value is popped.
+ * @param queue The queue.
+ * @param value The value to push.
+ */
+__songbird_header__
+void sb_mpmc_push(sb_mpmc_t *queue, void const *value);
+
+/**
+ * Pops the value at the front of the queue, waiting for one if it is empty.
+ * The wait spins briefly and then sleeps until a value is pushed.
+ * @param queue The queue.
+ * @return The value at the front of the queue.
+ */
+__songbird_header__
+void const *sb_mpmc_pop(sb_mpmc_t *queue);
+
+/**
+ * Pushes as many of the given values as there is room for, in order, with
+ * a single claim on the back of the queue. Values pushed by one call stay
+ * together.
+ * @param queue The queue.
+ * @param values The values to push.
+ * @param count The number of values.
+ * @return The number of values pushed.
+ */
+__songbird_header__
+unsigned sb_mpmc_try_push_many(sb_mpmc_t *queue, void const **values,
+	unsigned count);
+
+/**
+ * Pops up to max values from the front of the queue, in order, with a
+ * single claim on the front of the queue.
+ * @param queue The queue.
+ * @param values Where to store the values.
+ * @param max The maximum number of values to pop.
+ * @return The number of values popped.
+ */
+__songbird_header__
+unsigned sb_mpmc_try_pop_many(sb_mpmc_t *queue, void const **values,
+	unsigned max);
+
+/**
+ * Pops at least one and up to max values from the front of the queue,
+ * waiting for a value if it is empty.
+ * @param queue The queue.
+ * @param values Where to store the values.
+ * @param max The maximum number of values to pop, at least 1.
+ * @return The number of values popped.
+ */
+__songbird_header__
+unsigned sb_mpmc_pop_many(sb_mpmc_t *queue, void const **values,
+	unsigned max);
+
+/* function definitions */
+
+/**
+ * Tells the processor the thread is spinning. This function is not
+ * designed to be called by the end user.
+ */
+__songbird_header__
+void __sb_queue_relax(void) {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_ia32_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * Sleeps while the event counter still holds the given value, for at most
+ * SB_QUEUE_SLEEP milliseconds, or just gives up the processor where there
+ * is no futex. This function is not designed to be called by the end user.
+ */
+__songbird_header__
+void __sb_queue_wait(__sb_atomic_t(unsigned) *event, unsigned value) {
+#ifdef __SB_QUEUE_FUTEX__
+	struct timespec timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_nsec = SB_QUEUE_SLEEP * 1000000L;
+	syscall(SYS_futex, (unsigned *)event, FUTEX_WAIT_PRIVATE, value, &timeout, NULL, 0);
+#elif defined(_WIN32)
+	(void)event;
+	(void)value;
+	SwitchToThread();
+#else
+	(void)event;
+	(void)value;
+	sched_yield();
+#endif
+}
+
+/**
+ * Wakes the threads waiting for the event if there are any. This function is
+ * not designed to be called by the end user.
+ */
+__songbird_header__
+void __sb_queue_signal(__sb_atomic_t(unsigned) *event,
+		__sb_atomic_t(unsigned) *waiters, int count) {
+	/* pairs with the fence in the blocking calls, one of the two sees the other */
+	__sb_atomic_fence(SEQ_CST);
+	if(__sb_atomic_load(waiters, RELAXED) == 0) {
+		return;
+	}
+	__sb_atomic_add(event, 1, RELEASE);
+#ifdef __SB_QUEUE_FUTEX__
+	syscall(SYS_futex, (unsigned *)event, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#else
+	(void)count;
+#endif
+}
+
+__songbird_header__
+void sb_mpmc_init(sb_mpmc_t *queue, unsigned capacity) {
+	sb_mpmc_init_alloc(queue, capacity, NULL);
+}
+
+__songbird_header__
+void sb_mpmc_init_alloc(sb_mpmc_t *queue, unsigned capacity,
+		sb_allocator_t const *allocator) {
+	unsigned n = SB_QUEUE_DEFAULT_CAPACITY;
+	unsigned i;
+	if(capacity != 0) {
+		for(n = 2; n < capacity && n * 2 > n; n *= 2);
+	}
+	*(unsigned *)&queue->capacity = n;
+	queue->allocator = allocator;
+	queue->slots = (struct __sb_mpmc_slot *)__sb_allocate(allocator,
+			sizeof(struct __sb_mpmc_slot) * n);
+	if(queue->slots == NULL) {
+		*(unsigned *)&queue->capacity = 0;
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+	}
+	/* slot i is free for the producer of position i */
+	for(i = 0; queue->slots && i < n; ++i) {
+		__sb_atomic_store(&queue->slots[i].sequence, i, RELAXED);
+	}
+	__sb_atomic_store(&queue->front, 0, RELAXED);
+	__sb_atomic_store(&queue->blocking, 0, RELAXED);
+	__sb_atomic_store(&queue->pushed, 0, RELAXED);
+	__sb_atomic_store(&queue->popped, 0, RELAXED);
+	__sb_atomic_store(&queue->push_waiters, 0, RELAXED);
+	__sb_atomic_store(&queue->pop_waiters, 0, RELAXED);
+	__sb_atomic_store(&queue->back, 0, RELEASE);
+}
+
+__songbird_header__
+void sb_mpmc_free(sb_mpmc_t *queue) {
+	if(!queue) {
+		return;
+	}
+	__sb_deallocate(queue->allocator, queue->slots);
+	queue->slots = NULL;
+}
+
+__songbird_header__
+unsigned sb_mpmc_size(sb_mpmc_t *queue) {
+	unsigned front = __sb_atomic_load(&queue->front, ACQUIRE);
+	unsigned back = __sb_atomic_load(&queue->back, ACQUIRE);
+	/* the two loads are not taken at once, front may have passed back */
+	return (int)(back - front) > 0 ? back - front : 0;
+}
+
+/*
+ * A slot whose sequence equals the position is free for the producer of
+ * that position, one past the position means it holds the value for the
+ * consumer of that position. After the pop the sequence moves a whole lap
+ * ahead. The sequences run freely like the indices of sb_spsc_t.
+ */
+
+__songbird_header__
+unsigned sb_mpmc_try_push_many(sb_mpmc_t *queue, void const **values,
+		unsigned count) {
+	unsigned mask = queue->capacity - 1;
+	unsigned back = __sb_atomic_load(&queue->back, RELAXED);
+	unsigned ready, i;
+	struct __sb_mpmc_slot *slot;
+	for(;;) {
+		/* claim the run of free slots, a free slot stays free until claimed */
+		for(ready = 0; ready < count; ++ready) {
+			slot = &queue->slots[(back + ready) & mask];
+			if(__sb_atomic_load(&slot->sequence, ACQUIRE) != back + ready) {
+				break;
+			}
+		}
+		if(ready == 0) {
+			slot = &queue->slots[back & mask];
+			if((int)(__sb_atomic_load(&slot->sequence, ACQUIRE) - back) < 0) {
+				return 0; /* full */
+			}
+			/* another producer got here first */
+			back = __sb_atomic_load(&queue->back, RELAXED);
+			continue;
+		}
+		if(__sb_atomic_cas(&queue->back, &back, back + ready, RELAXED)) {
+			break;
+		}
+	}
+	for(i = 0; i < ready; ++i) {
+		slot = &queue->slots[(back + i) & mask];
+		slot->value = values[i];
+		__sb_atomic_store(&slot->sequence, back + i + 1, RELEASE);
+	}
+	if(__sb_atomic_load(&queue->blocking, RELAXED)) {
+		__sb_queue_signal(&queue->pushed, &queue->pop_waiters, (int)ready);
+	}
+	return ready;
+}
+
+__songbird_header__
+int sb_mpmc_try_push(sb_mpmc_t *queue, void const *value) {
+	return (int)sb_mpmc_try_push_many(queue, &value, 1);
+}
+
+__songbird_header__
+unsigned sb_mpmc_try_pop_many(sb_mpmc_t *queue, void const **values,
+		unsigned max) {
+	unsigned mask = queue->capacity - 1;
+	unsigned front = __sb_atomic_load(&queue->front, RELAXED);
+	unsigned ready, i;
+	struct __sb_mpmc_slot *slot;
+	for(;;) {
+		for(ready = 0; ready < max; ++ready) {
+			slot = &queue->slots[(front + ready) & mask];
+			if(__sb_atomic_load(&slot->sequence, ACQUIRE) != front + ready + 1) {
+				break;
+			}
+		}
+		if(ready == 0) {
+			slot = &queue->slots[front & mask];
+			if((int)(__sb_atomic_load(&slot->sequence, ACQUIRE) - (front + 1)) < 0) {
+				return 0; /* empty */
+			}
+			/* another consumer got here first */
+			front = __sb_atomic_load(&queue->front, RELAXED);
+			continue;
+		}
+		if(__sb_atomic_cas(&queue->front, &front, front + ready, RELAXED)) {
+			break;
+		}
+	}
+	for(i = 0; i < ready; ++i) {
+		slot = &queue->slots[(front + i) & mask];
+		values[i] = slot->value;
+		__sb_atomic_store(&slot->sequence, front + i + mask + 1, RELEASE);
+	}
+	if(__sb_atomic_load(&queue->blocking, RELAXED)) {
+		__sb_queue_signal(&queue->popped, &queue->push_waiters, (int)ready);
+	}
+	return ready;
+}
+
+__songbird_header__
+int sb_mpmc_try_pop(sb_mpmc_t *queue, void const **value) {
+	return (int)sb_mpmc_try_pop_many(queue, value, 1);
+}
+
+__songbird_header__
+unsigned sb_mpmc_pop_many(sb_mpmc_t *queue, void const **values,
+		unsigned max) {
+	unsigned count;
+	unsigned event;
+	int spin;
+	for(;;) {
+		for(spin = 0; spin < SB_QUEUE_SPIN; ++spin) {
+			if((count = sb_mpmc_try_pop_many(queue, values, max)) > 0) {
+				return count;
+			}
+			__sb_queue_relax();
+		}
+		/* read the event before the last try so a push after it wakes us */
+		if(__sb_atomic_load(&queue->blocking, RELAXED) == 0) {
+			__sb_atomic_store(&queue->blocking, 1, RELAXED);
+		}
+		event = __sb_atomic_load(&queue->pushed, ACQUIRE);
+		__sb_atomic_add(&queue->pop_waiters, 1, RELAXED);
+		__sb_atomic_fence(SEQ_CST);
+		count = sb_mpmc_try_pop_many(queue, values, max);
+		if(count == 0) {
+			__sb_queue_wait(&queue->pushed, event);
+		}
+		__sb_atomic_add(&queue->pop_waiters, (unsigned)-1, RELAXED);
+		if(count > 0) {
+			return count;
+		}
+	}
+}
+
+__songbird_header__
+void const *sb_mpmc_pop(sb_mpmc_t *queue) {
+	void const *value;
+	sb_mpmc_pop_many(queue, &value, 1);
+	return value;
+}
+
+__songbird_header__
+void sb_mpmc_push(sb_mpmc_t *queue, void const *value) {
+	unsigned event;
+	int spin;
+	for(;;) {
+		for(spin = 0; spin < SB_QUEUE_SPIN; ++spin) {
+			if(sb_mpmc_try_push(queue, value)) {
+				return;
+			}
+			__sb_queue_relax();
+		}
+		if(__sb_atomic_load(&queue->blocking, RELAXED) == 0) {
+			__sb_atomic_store(&queue->blocking, 1, RELAXED);
+		}
+		event = __sb_atomic_load(&queue->popped, ACQUIRE);
+		__sb_atomic_add(&queue->push_waiters, 1, RELAXED);
+		__sb_atomic_fence(SEQ_CST);
+		if(sb_mpmc_try_push(queue, value)) {
+			__sb_atomic_add(&queue->push_waiters, (unsigned)-1, RELAXED);
+			return;
+		}
+		__sb_queue_wait(&queue->popped, event);
+		__sb_atomic_add(&queue->push_waiters, (unsigned)-1, RELAXED);
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef __songbird_header__
+
+#endif /* __SONGBIRD_QUEUE_H__ */
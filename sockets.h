@@ -22,16 +22,43 @@
 #ifndef __SONGBIRD_SOCKETS_H__
 #define __SONGBIRD_SOCKETS_H__
 
+/*
+ * Strict C modes hide the POSIX and BSD functions used below, and Linux only
+ * declares recvmmsg, sendmmsg and splice with _GNU_SOURCE. This asks for
+ * them, but only works if no system header was included before this file,
+ * otherwise compile with _GNU_SOURCE (_DEFAULT_SOURCE off Linux) defined.
+ */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#elif !defined(_WIN32) && !defined(_DEFAULT_SOURCE) && !defined(_GNU_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #else
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <limits.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <netinet/udp.h>
+#include <sys/sendfile.h>
+/* glibc only declares these if _GNU_SOURCE was seen before its first header */
+#if defined(_GNU_SOURCE) && (!defined(__GLIBC__) || defined(__USE_GNU))
+#define __SB_SOCK_MMSG__
+#define __SB_SOCK_SPLICE__
+#endif
+#endif
 #endif
 
 #ifdef __cplusplus
@@ -53,6 +80,13 @@ extern "C" {
 #ifdef _WIN32
 #define EWOULDBLOCK	WSAEWOULDBLOCK
 #define EAGAIN	WSAEINTR
+#define poll	WSAPoll
+#else
+#define SOCKET_ERROR	-1
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX	1024
 #endif
 
 /* A generic simple sockets wrapper. Not perfect. */
@@ -69,9 +103,22 @@ enum {
 typedef int sb_socket_t;
 typedef int sb_ssocket_t;
 
+typedef int sb_dsocket_t;
+
+/* One piece of a scatter/gather operation. */
+#ifdef _WIN32
+typedef WSABUF sb_iovec_t;
+#else
+typedef struct iovec sb_iovec_t;
+#endif
+
 __songbird_header__	int sb_sockets_start();
 __songbird_header__	void sb_sockets_stop();
 __songbird_header__	int sb_sockets_set_non_blocking(sb_socket_t *);
+/* waits up to timeout milliseconds (-1 forever) for the socket to become readable, returns SB_SOCK_NONE on timeout */
+__songbird_header__	int sb_sockets_can_read(sb_socket_t *, int timeout);
+/* waits up to timeout milliseconds (-1 forever) for the socket to become writable, returns SB_SOCK_NONE on timeout */
+__songbird_header__	int sb_sockets_can_write(sb_socket_t *, int timeout);
 
 
 /* Client Sockets */
@@ -82,6 +129,74 @@ __songbird_header__	int sb_socket_read(sb_socket_t *, char *, unsigned);
 __songbird_header__	int sb_socket_remote_address(sb_socket_t *, char *, unsigned, unsigned short *);
 
 
+/* Scatter/Gather */
+__songbird_header__	void sb_iovec_set(sb_iovec_t *, void const *, unsigned);
+/* writes the pieces in order with one call, returns the number of bytes written like sb_socket_write */
+__songbird_header__	int sb_socket_writev(sb_socket_t *, sb_iovec_t *, unsigned);
+/* reads into the pieces in order with one call, returns the number of bytes read like sb_socket_read */
+__songbird_header__	int sb_socket_readv(sb_socket_t *, sb_iovec_t *, unsigned);
+/* skips the given number of bytes after a short write or read, updating the array pointer and count */
+__songbird_header__	void sb_iovec_advance(sb_iovec_t **, unsigned *, unsigned);
+
+
+/* Datagram Sockets */
+
+/* most datagrams moved by one call to sb_dsocket_recv or sb_dsocket_send */
+enum {
+	SB_SOCK_DGRAM_BATCH = 64
+};
+
+/*
+ * A message slot for sb_dsocket_recv and sb_dsocket_send. The buffers are
+ * owned by the caller, so a whole array of slots can point into one arena.
+ */
+typedef struct sb_datagram {
+	/* the data to send, or the space to receive into */
+	char *buf;
+	/* the size of buf */
+	unsigned size;
+	/* the number of bytes to send, or the number of bytes received */
+	unsigned len;
+	/* the destination, or where the datagram came from */
+	struct sockaddr_in addr;
+	/*
+	 * When sending, split buf into datagrams of this size in the kernel (GSO).
+	 * When receiving with GRO enabled, buf holds several datagrams of this size
+	 * back to back, the last one may be shorter. 0 for a single datagram.
+	 */
+	unsigned segment;
+} sb_datagram_t;
+
+/* opens a UDP socket bound to the given port, 0 for any port */
+__songbird_header__	int sb_dsocket_open(sb_dsocket_t *, unsigned short);
+__songbird_header__	void sb_dsocket_close(sb_dsocket_t *);
+/* lets the kernel merge datagrams from the same flow into one slot, returns SB_SOCK_ERROR if not supported */
+__songbird_header__	int sb_dsocket_enable_gro(sb_dsocket_t *);
+__songbird_header__	int sb_datagram_set_address(sb_datagram_t *, const char *, unsigned short);
+/* fills up to count slots, returns the number of datagrams received, SB_SOCK_NONE if there are none */
+__songbird_header__	int sb_dsocket_recv(sb_dsocket_t *, sb_datagram_t *, unsigned);
+/* sends up to count slots, returns the number of slots sent, SB_SOCK_NONE if none could be sent */
+__songbird_header__	int sb_dsocket_send(sb_dsocket_t *, sb_datagram_t *, unsigned);
+
+
+#ifndef _WIN32
+/* File Transfer */
+
+/*
+ * Sends len bytes of the file starting at *offset without copying them
+ * through user space where the system allows it (sendfile, or splice for
+ * pipes on Linux). *offset is advanced past what was sent, so on a non
+ * blocking socket the call can simply be repeated once the socket is
+ * writable. Returns the number of bytes sent like sb_socket_write.
+ * Elsewhere pipes are copied through a buffer, and bytes read from the pipe
+ * that a non blocking socket does not take are lost.
+ */
+__songbird_header__	int sb_socket_send_fd(sb_socket_t *, int, off_t *, unsigned);
+/* as sb_socket_send_fd, opening the file by name */
+__songbird_header__	int sb_socket_send_file(sb_socket_t *, const char *, off_t *, unsigned);
+#endif
+
+
 /* Server Sockets */
 __songbird_header__	int sb_ssocket_open(sb_ssocket_t *, unsigned short, int queue);
 /* use sb_sockets_can_read to determine if there is a waiting connection to avoid blocking */
@@ -120,22 +235,50 @@ int sb_sockets_set_non_blocking(sb_socket_t *sock) {
 	}
 #else
 	int flags = 0;
-	if ((flags = fcntl(fd, F_GETFL, 0)) == -1)
+	if ((flags = fcntl(*sock, F_GETFL, 0)) == -1)
 		flags = 0;
-	if(fcntl(fd, F_SETFL, flags | O_NONBLOCK)) {
+	if(fcntl(*sock, F_SETFL, flags | O_NONBLOCK)) {
 		return SB_SOCK_ERROR;
 	}
 #endif
 	return SB_SOCK_OK;
 }
+__songbird_header__
+int __sb_sockets_wait(sb_socket_t *sock, short events, int timeout) {
+	struct pollfd pfd;
+	int result;
+	pfd.fd = *sock;
+	pfd.events = events;
+	pfd.revents = 0;
+	result = poll(&pfd, 1, timeout);
+	if(result < 0) {
+		return errno == EINTR ? SB_SOCK_NONE : SB_SOCK_ERROR;
+	}
+	if(result == 0) {
+		return SB_SOCK_NONE;
+	}
+	/* errors and hangups count as ready so the following call reports them */
+	return SB_SOCK_OK;
+}
+
+__songbird_header__
+int sb_sockets_can_read(sb_socket_t *sock, int timeout) {
+	return __sb_sockets_wait(sock, POLLIN, timeout);
+}
+
+__songbird_header__
+int sb_sockets_can_write(sb_socket_t *sock, int timeout) {
+	return __sb_sockets_wait(sock, POLLOUT, timeout);
+}
+
 /*
     / * Fixme: O_NONBLOCK is defined but broken on SunOS 4.1.x and AIX 3.2.5. * /
     
 	*/
 
 __songbird_header__
-int __sb_socket_init(sb_socket_t *sock) {
-	*sock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+int __sb_socket_init(sb_socket_t *sock, int type, int protocol) {
+	*sock = socket(PF_INET, type, protocol);
 	if(*sock < 0) {
 		return SB_SOCK_ERROR;
 	}
@@ -146,7 +289,7 @@ int __sb_socket_init(sb_socket_t *sock) {
 __songbird_header__
 int sb_socket_open(sb_socket_t *sock, const char *ip, unsigned short port) {
 	struct sockaddr_in addr;
-	if(__sb_socket_init(sock) == SB_SOCK_ERROR) {
+	if(__sb_socket_init(sock, SOCK_STREAM, IPPROTO_TCP) == SB_SOCK_ERROR) {
 		return SB_SOCK_ERROR;
 	}
 	memset(&addr, 0, sizeof(addr));
@@ -175,14 +318,17 @@ void sb_socket_close(sb_socket_t *sock) {
 __songbird_header__
 int sb_socket_write(sb_socket_t *sock, const char *buf, unsigned len) {
 #ifdef __APPLE__
-	int sent = write(sock, buf, len);
+	int sent = write(*sock, buf, len);
 #else
 	int sent = send(*sock, buf, len, 0);
-	if(sent == SOCKET_ERROR) {
+#endif
 #ifdef _WIN32
+	if(sent == SOCKET_ERROR) {
+		if(WSAGetLastError() == WSAEWOULDBLOCK) {
+			return SB_SOCK_NONE;
+		}
 		/* socket crash */
 		sb_socket_close(sock);
-#endif
 		return SB_SOCK_ERROR;
 	}
 #endif
@@ -218,7 +364,7 @@ int sb_socket_read(sb_socket_t *sock, char *buf, unsigned len) {
 __songbird_header__
 int sb_socket_remote_address(sb_socket_t *sock, char *buf, unsigned len, unsigned short *port) {
 	struct sockaddr_in addr;
-	int addr_len = sizeof(addr);
+	socklen_t addr_len = sizeof(addr);
 	if(getpeername(*sock, (struct sockaddr *) &addr, &addr_len) < 0) {
 		return SB_SOCK_ERROR;
 	}
@@ -227,10 +373,535 @@ int sb_socket_remote_address(sb_socket_t *sock, char *buf, unsigned len, unsigne
 	return SB_SOCK_OK;
 }
 
+__songbird_header__
+void sb_iovec_set(sb_iovec_t *iov, void const *buf, unsigned len) {
+#ifdef _WIN32
+	iov->buf = (char *)buf;
+	iov->len = len;
+#else
+	iov->iov_base = (void *)buf;
+	iov->iov_len = len;
+#endif
+}
+
+__songbird_header__
+int sb_socket_writev(sb_socket_t *sock, sb_iovec_t *iov, unsigned count) {
+#ifdef _WIN32
+	DWORD sent = 0;
+	if(WSASend(*sock, iov, count, &sent, 0, NULL, NULL) == SOCKET_ERROR) {
+		if(WSAGetLastError() == WSAEWOULDBLOCK) {
+			return SB_SOCK_NONE;
+		}
+		return SB_SOCK_ERROR;
+	}
+	return (int)sent;
+#else
+	int sent;
+	if(count > IOV_MAX) {
+		count = IOV_MAX; /* reported as a short write */
+	}
+	sent = writev(*sock, iov, count);
+	if(sent < 0) {
+		if(errno == EAGAIN || errno == EWOULDBLOCK) {
+			return SB_SOCK_NONE;
+		}
+		return SB_SOCK_ERROR;
+	}
+	return sent;
+#endif
+}
+
+__songbird_header__
+int sb_socket_readv(sb_socket_t *sock, sb_iovec_t *iov, unsigned count) {
+#ifdef _WIN32
+	DWORD received = 0;
+	DWORD flags = 0;
+	if(WSARecv(*sock, iov, count, &received, &flags, NULL, NULL) == SOCKET_ERROR) {
+		if(WSAGetLastError() == WSAEWOULDBLOCK) {
+			return SB_SOCK_NONE;
+		}
+		return SB_SOCK_ERROR;
+	}
+	return (int)received;
+#else
+	int result;
+	if(count > IOV_MAX) {
+		count = IOV_MAX;
+	}
+	result = readv(*sock, iov, count);
+	if(result < 0) {
+		if(errno == EAGAIN || errno == EWOULDBLOCK) {
+			return SB_SOCK_NONE;
+		}
+		return SB_SOCK_ERROR;
+	}
+	return result;
+#endif
+}
+
+__songbird_header__
+void sb_iovec_advance(sb_iovec_t **iov, unsigned *count, unsigned len) {
+#ifdef _WIN32
+	while(*count > 0 && len >= (*iov)->len) {
+		len -= (*iov)->len;
+		++*iov;
+		--*count;
+	}
+	if(*count > 0) {
+		(*iov)->buf += len;
+		(*iov)->len -= len;
+	}
+#else
+	while(*count > 0 && len >= (*iov)->iov_len) {
+		len -= (unsigned)(*iov)->iov_len;
+		++*iov;
+		--*count;
+	}
+	if(*count > 0) {
+		(*iov)->iov_base = (char *)(*iov)->iov_base + len;
+		(*iov)->iov_len -= len;
+	}
+#endif
+}
+
+#ifdef __SONGBIRD_BUFFER_H__
+/*
+ * These are only available when buffer.h is included before this file.
+ */
+
+enum {
+	/* most buffers sent by one call to sb_socket_write_buffers */
+	SB_SOCK_BUFFER_BATCH = 64
+};
+
+/**
+ * Sends the unread bytes of several buffers with a single call and consumes
+ * whatever was sent from each of them. Returns the number of bytes written
+ * like sb_socket_write.
+ */
+__songbird_header__
+int sb_socket_write_buffers(sb_socket_t *sock, sb_buffer_t **buffers, unsigned count) {
+	sb_iovec_t iov[SB_SOCK_BUFFER_BATCH];
+	unsigned i, len;
+	unsigned char const *data;
+	int sent;
+	if(count > SB_SOCK_BUFFER_BATCH) {
+		count = SB_SOCK_BUFFER_BATCH;
+	}
+	for(i = 0; i < count; ++i) {
+		data = sb_buffer_peek(buffers[i], &len);
+		sb_iovec_set(&iov[i], data, len);
+	}
+	sent = sb_socket_writev(sock, iov, count);
+	if(sent > 0) {
+		len = (unsigned)sent;
+		for(i = 0; i < count && len > 0; ++i) {
+			len -= sb_buffer_consume(buffers[i], len);
+		}
+	}
+	return sent;
+}
+
+/**
+ * Reads up to the given number of bytes straight into the end of the
+ * buffer. Returns the number of bytes read like sb_socket_read.
+ */
+__songbird_header__
+int sb_socket_read_buffer(sb_socket_t *sock, sb_buffer_t *buffer, unsigned len) {
+	int result;
+	unsigned char *tail = sb_buffer_prepare(buffer, len);
+	if(tail == NULL) {
+		return SB_SOCK_ERROR;
+	}
+	result = sb_socket_read(sock, (char *)tail, len);
+	if(result > 0) {
+		sb_buffer_commit(buffer, (unsigned)result);
+	}
+	return result;
+}
+#endif /* __SONGBIRD_BUFFER_H__ */
+
+__songbird_header__
+int sb_dsocket_open(sb_dsocket_t *sock, unsigned short port) {
+	struct sockaddr_in addr;
+	if(__sb_socket_init(sock, SOCK_DGRAM, IPPROTO_UDP) == SB_SOCK_ERROR) {
+		return SB_SOCK_ERROR;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if(bind(*sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		sb_dsocket_close(sock);
+		return SB_SOCK_ERROR;
+	}
+	return SB_SOCK_OK;
+}
+
+__songbird_header__
+void sb_dsocket_close(sb_dsocket_t *sock) {
+#ifdef _WIN32
+	closesocket(*sock);
+#else
+	close(*sock);
+#endif
+	*sock = -1;
+}
+
+__songbird_header__
+int sb_dsocket_enable_gro(sb_dsocket_t *sock) {
+#if defined(__SB_SOCK_MMSG__) && defined(UDP_GRO)
+	int on = 1;
+	if(setsockopt(*sock, IPPROTO_UDP, UDP_GRO, &on, sizeof(on)) < 0) {
+		return SB_SOCK_ERROR;
+	}
+	return SB_SOCK_OK;
+#else
+	(void)sock;
+	return SB_SOCK_ERROR;
+#endif
+}
+
+__songbird_header__
+int sb_datagram_set_address(sb_datagram_t *gram, const char *ip, unsigned short port) {
+	memset(&gram->addr, 0, sizeof(gram->addr));
+	gram->addr.sin_family = AF_INET;
+	gram->addr.sin_addr.s_addr = inet_addr(ip);
+	gram->addr.sin_port = htons(port);
+	return SB_SOCK_OK;
+}
+
+/**
+ * Determines if the last failed call would have blocked. This function is
+ * not designed to be called by the end user.
+ */
+__songbird_header__
+int __sb_dsocket_would_block(void) {
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/**
+ * Sends one datagram per call, splitting each slot into datagrams of its
+ * segment size. Used where the batched calls do not exist and where the
+ * kernel or device refuses segmentation offload. This function is not
+ * designed to be called by the end user.
+ */
+__songbird_header__
+int __sb_dsocket_send_each(sb_dsocket_t *sock, sb_datagram_t *grams, unsigned count) {
+	unsigned i, offset, len;
+	int result;
+	for(i = 0; i < count; ++i) {
+		/* without segmentation offload split the slot here */
+		len = grams[i].segment > 0 ? grams[i].segment : grams[i].len;
+		for(offset = 0; offset < grams[i].len || offset == 0; offset += len) {
+			if(len > grams[i].len - offset) {
+				len = grams[i].len - offset;
+			}
+			result = sendto(*sock, grams[i].buf + offset, len, 0,
+					(struct sockaddr *)&grams[i].addr, sizeof(grams[i].addr));
+			if(result < 0) {
+				if(i > 0) {
+					return (int)i;
+				}
+				if(__sb_dsocket_would_block()) {
+					return SB_SOCK_NONE;
+				}
+				return SB_SOCK_ERROR;
+			}
+			if(len == 0) {
+				break;
+			}
+		}
+	}
+	return (int)i;
+}
+
+#ifdef __SB_SOCK_MMSG__
+
+/* room for one int sized control message per slot */
+#define __SB_SOCK_CONTROL	CMSG_SPACE(sizeof(int))
+
+__songbird_header__
+int sb_dsocket_recv(sb_dsocket_t *sock, sb_datagram_t *grams, unsigned count) {
+	struct mmsghdr msgs[SB_SOCK_DGRAM_BATCH];
+	struct iovec iov[SB_SOCK_DGRAM_BATCH];
+	char control[SB_SOCK_DGRAM_BATCH][__SB_SOCK_CONTROL];
+	struct cmsghdr *cmsg;
+	unsigned i;
+	int result;
+	if(count > SB_SOCK_DGRAM_BATCH) {
+		count = SB_SOCK_DGRAM_BATCH;
+	}
+	memset(msgs, 0, sizeof(struct mmsghdr) * count);
+	for(i = 0; i < count; ++i) {
+		iov[i].iov_base = grams[i].buf;
+		iov[i].iov_len = grams[i].size;
+		msgs[i].msg_hdr.msg_name = &grams[i].addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof(grams[i].addr);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = control[i];
+		msgs[i].msg_hdr.msg_controllen = __SB_SOCK_CONTROL;
+	}
+	/* block (if blocking) for the first one, then take whatever is queued */
+	result = recvmmsg(*sock, msgs, count, MSG_WAITFORONE, NULL);
+	if(result < 0) {
+		if(errno == EAGAIN || errno == EWOULDBLOCK) {
+			return SB_SOCK_NONE;
+		}
+		return SB_SOCK_ERROR;
+	}
+	for(i = 0; i < (unsigned)result; ++i) {
+		grams[i].len = msgs[i].msg_len;
+		grams[i].segment = 0;
+#ifdef UDP_GRO
+		for(cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg != NULL;
+				cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+			if(cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+				int segment;
+				memcpy(&segment, CMSG_DATA(cmsg), sizeof(segment));
+				grams[i].segment = (unsigned)segment;
+			}
+		}
+#else
+		(void)cmsg;
+#endif
+	}
+	return result;
+}
+
+__songbird_header__
+int sb_dsocket_send(sb_dsocket_t *sock, sb_datagram_t *grams, unsigned count) {
+	struct mmsghdr msgs[SB_SOCK_DGRAM_BATCH];
+	struct iovec iov[SB_SOCK_DGRAM_BATCH];
+#ifdef UDP_SEGMENT
+	char control[SB_SOCK_DGRAM_BATCH][__SB_SOCK_CONTROL];
+	struct cmsghdr *cmsg;
+	unsigned short segment;
+	int offload = 0;
+#endif
+	unsigned i;
+	int result;
+	if(count > SB_SOCK_DGRAM_BATCH) {
+		count = SB_SOCK_DGRAM_BATCH;
+	}
+	memset(msgs, 0, sizeof(struct mmsghdr) * count);
+	for(i = 0; i < count; ++i) {
+		iov[i].iov_base = grams[i].buf;
+		iov[i].iov_len = grams[i].len;
+		msgs[i].msg_hdr.msg_name = &grams[i].addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof(grams[i].addr);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef UDP_SEGMENT
+		if(grams[i].segment > 0 && grams[i].segment < grams[i].len) {
+			/* generic segmentation offload, one slot becomes many datagrams */
+			memset(control[i], 0, __SB_SOCK_CONTROL);
+			msgs[i].msg_hdr.msg_control = control[i];
+			msgs[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(unsigned short));
+			cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+			cmsg->cmsg_level = IPPROTO_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned short));
+			segment = (unsigned short)grams[i].segment;
+			memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+			offload = 1;
+		}
+#endif
+	}
+	result = sendmmsg(*sock, msgs, count, 0);
+	if(result < 0) {
+		if(errno == EAGAIN || errno == EWOULDBLOCK) {
+			return SB_SOCK_NONE;
+		}
+#ifdef UDP_SEGMENT
+		/* older kernels and devices without checksum offload refuse GSO */
+		if(offload && (errno == EINVAL || errno == EIO)) {
+			return __sb_dsocket_send_each(sock, grams, count);
+		}
+#endif
+		return SB_SOCK_ERROR;
+	}
+	return result;
+}
+
+#undef __SB_SOCK_CONTROL
+
+#else /* __SB_SOCK_MMSG__ */
+
+/* one call per datagram where the batched calls do not exist */
+
+__songbird_header__
+int sb_dsocket_recv(sb_dsocket_t *sock, sb_datagram_t *grams, unsigned count) {
+	unsigned i;
+	int result;
+	socklen_t addr_len;
+	for(i = 0; i < count; ++i) {
+		/* only the first receive may block, like MSG_WAITFORONE */
+		if(i > 0 && sb_sockets_can_read(sock, 0) != SB_SOCK_OK) {
+			break;
+		}
+		addr_len = sizeof(grams[i].addr);
+		result = recvfrom(*sock, grams[i].buf, grams[i].size, 0,
+				(struct sockaddr *)&grams[i].addr, &addr_len);
+		if(result < 0) {
+			if(__sb_dsocket_would_block()) {
+				break;
+			}
+			return i > 0 ? (int)i : SB_SOCK_ERROR;
+		}
+		grams[i].len = (unsigned)result;
+		grams[i].segment = 0;
+	}
+	return i > 0 ? (int)i : SB_SOCK_NONE;
+}
+
+__songbird_header__
+int sb_dsocket_send(sb_dsocket_t *sock, sb_datagram_t *grams, unsigned count) {
+	return __sb_dsocket_send_each(sock, grams, count);
+}
+
+#endif /* __SB_SOCK_MMSG__ */
+
+#ifndef _WIN32
+
+/**
+ * Copies through a buffer, for descriptors the kernel can not send from
+ * directly. Bytes read from a descriptor that can not seek can not be read
+ * again, so they are only taken while the socket is writable, and a blocking
+ * socket is written until it has all of them. A non blocking socket that
+ * takes only part of them loses the rest. This function is not designed to
+ * be called by the end user.
+ */
+__songbird_header__
+int __sb_socket_send_copy(sb_socket_t *sock, int fd, off_t *offset, unsigned len, int seekable) {
+	char buf[16384];
+	unsigned total = 0;
+	ssize_t got, done;
+	int sent;
+	int blocking = !(fcntl(*sock, F_GETFL) & O_NONBLOCK);
+	while(total < len) {
+		size_t chunk = len - total < sizeof(buf) ? len - total : sizeof(buf);
+		if(seekable) {
+			got = pread(fd, buf, chunk, *offset);
+		} else {
+			if(!blocking && sb_sockets_can_write(sock, 0) != SB_SOCK_OK) {
+				return total > 0 ? (int)total : SB_SOCK_NONE;
+			}
+			got = read(fd, buf, chunk);
+		}
+		if(got <= 0) {
+			break;
+		}
+		done = 0;
+		do {
+			sent = sb_socket_write(sock, buf + done, (unsigned)(got - done));
+			if(sent > 0) {
+				done += sent;
+			}
+		} while(sent > 0 && done < got && !seekable && blocking);
+		if(done == 0) {
+			if(total > 0) {
+				break;
+			}
+			return sent;
+		}
+		*offset += done;
+		total += (unsigned)done;
+		if(done < got) {
+			break; /* the rest is read again next time, unless it came from a pipe */
+		}
+	}
+	return (int)total;
+}
+
+__songbird_header__
+int sb_socket_send_fd(sb_socket_t *sock, int fd, off_t *offset, unsigned len) {
+	unsigned total = 0;
+#if defined(__linux__)
+	ssize_t sent;
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+	off_t sent;
+	int result;
+#endif
+	if(len > INT_MAX) {
+		len = INT_MAX;
+	}
+	while(total < len) {
+#if defined(__linux__)
+		off_t position = *offset;
+		sent = sendfile(*sock, fd, &position, len - total);
+#ifdef __SB_SOCK_SPLICE__
+		if(sent < 0 && (errno == EINVAL || errno == ESPIPE)) {
+			/* pipes can not be sent from, but they can be spliced */
+			sent = splice(fd, NULL, *sock, NULL, len - total, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		}
+#endif
+#elif defined(__APPLE__)
+		sent = len - total;
+		result = sendfile(fd, *sock, *offset, &sent, NULL, 0);
+		if(result < 0 && sent == 0) {
+			sent = -1;
+		}
+#elif defined(__FreeBSD__)
+		sent = 0;
+		result = sendfile(fd, *sock, *offset, len - total, NULL, &sent, 0);
+		if(result < 0 && sent == 0) {
+			sent = -1;
+		}
+#else
+		int sent = -1;
+		errno = EINVAL;
+#endif
+		if(sent < 0) {
+			if(errno == EINVAL || errno == ESPIPE || errno == ENOSYS || errno == EOPNOTSUPP) {
+				/* nothing sent yet, let the copy loop take it from here */
+				int copied = __sb_socket_send_copy(sock, fd, offset,
+						len - total, lseek(fd, 0, SEEK_CUR) >= 0);
+				if(copied < 0) {
+					return total > 0 ? (int)total : copied;
+				}
+				return (int)(total + copied);
+			}
+			if(total > 0) {
+				break;
+			}
+			if(errno == EAGAIN || errno == EWOULDBLOCK) {
+				return SB_SOCK_NONE;
+			}
+			return SB_SOCK_ERROR;
+		}
+		if(sent == 0) {
+			break; /* end of file */
+		}
+		*offset += sent;
+		total += (unsigned)sent;
+	}
+	return (int)total;
+}
+
+__songbird_header__
+int sb_socket_send_file(sb_socket_t *sock, const char *filename, off_t *offset, unsigned len) {
+	int result;
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		return SB_SOCK_ERROR;
+	}
+	result = sb_socket_send_fd(sock, fd, offset, len);
+	close(fd);
+	return result;
+}
+
+#endif /* _WIN32 */
+
 __songbird_header__
 int sb_ssocket_open(sb_ssocket_t *ssock, unsigned short port, int queue) {
 	struct sockaddr_in addr;
-	if(__sb_socket_init(ssock) == SB_SOCK_ERROR) {
+	if(__sb_socket_init(ssock, SOCK_STREAM, IPPROTO_TCP) == SB_SOCK_ERROR) {
 		return SB_SOCK_ERROR;
 	}
 	memset(&addr, 0, sizeof(addr));
@@ -0,0 +1,829 @@
+/**
+ * Copyright (c) 2014-2017 Robert Maupin <chasesan@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SONGBIRD_SORT_H__
+#define __SONGBIRD_SORT_H__
+
+#ifndef __SB_NO_ALLOC__
+#include <stdlib.h>
+#define sb_malloc malloc
+#define sb_realloc realloc
+#define sb_free free
+#endif /* __SB_NO_ALLOC__ */
+
+#include <string.h>
+
+#ifdef __cplusplus
+/* Not sure why you would want to use this in C++, but just in case. */
+extern "C" {
+#define __songbird_sort__	inline
+/* Works even if __STDC_VERSION__ is not defined. */
+#elif __STDC_VERSION__ <= 199409L
+#define __songbird_sort__	static __inline__
+#else
+#define __songbird_sort__	static inline
+#endif
+
+#ifndef __SB_ERROR__
+#define __SB_ERROR__
+enum {
+	SB_ERROR_NONE = 0,
+	SB_ERROR_MEMORY_ALLOCATION = 1,
+	SB_ERROR_OUT_OF_BOUNDS = 2,
+};
+#if __STDC_VERSION__ >= 201112L && !defined __STDC_NO_THREADS__
+__thread int sb_error = SB_ERROR_NONE;
+#else
+int sb_error = SB_ERROR_NONE;
+#endif
+#define sb_error() (sb_error)
+#define sb_error_clear() (sb_error = SB_ERROR_NONE)
+#endif
+
+#ifndef __songbird_compare_func__
+#define __songbird_compare_func__
+/** gets the context and two values, negative if a goes before b, 0 if equal */
+typedef int (*sb_compare_f)(void *context, void const *a, void const *b);
+#endif
+
+/** gets the context and a value, non-zero if it belongs in front */
+typedef int (*sb_predicate_f)(void *context, void const *value);
+
+/*
+ * Sorting, searching and partitioning. SB_SORT_DECLARE generates the
+ * algorithms for values of one type with an ordering the compiler can
+ * inline, the sb_* functions below are the same code run over arrays of
+ * pointers with a sb_compare_f, as stored by sb_vector_t and sb_array_t.
+ *
+ * The sort is an introsort: quicksort with a median of three pivot, or a
+ * median of medians for large ranges, that turns to heapsort when it goes
+ * too deep and to insertion sort for short ranges. A partition that moved
+ * nothing suggests the range is nearly sorted, so it is then finished by
+ * insertion sort if that takes only a few moves. The stable sort is a
+ * bottom up merge sort that skips merging runs already in order.
+ */
+
+enum {
+	/* ranges this short are insertion sorted */
+	SB_SORT_INSERTION_LIMIT = 16,
+	/* ranges this long choose their pivot from nine values */
+	SB_SORT_NINTHER_LIMIT = 128,
+	/* moves the insertion sort of a nearly sorted range may make */
+	SB_SORT_PARTIAL_LIMIT = 8,
+	/* run length the stable sort starts merging at */
+	SB_SORT_RUN = 32
+};
+
+/**
+ * Works out the recursion depth after which the sort turns to heapsort,
+ * twice the binary logarithm of count. This function is not designed to be
+ * called by the end user.
+ */
+__songbird_sort__
+unsigned __sb_sort_depth(unsigned count) {
+	unsigned depth = 0;
+	while(count > 1) {
+		count >>= 1;
+		depth += 2;
+	}
+	return depth;
+}
+
+/**
+ * Declares the sorting, searching and partitioning functions for values of
+ * type T. less is the name of a function or macro
+ *
+ *   int less(void *context, T const *a, T const *b);
+ *
+ * that returns non-zero if a goes before b, it gets the context passed to
+ * the generated functions. The same declaration must not be repeated in one
+ * translation unit. They work on any storage of T, including the entries of
+ * a vector declared by SB_VECTOR_DECLARE.
+ *
+ *   void name##_sort(T *values, unsigned count, void *context);
+ *   int name##_sort_stable(T *values, unsigned count, void *context);
+ *   unsigned name##_lower_bound(T const *values, unsigned count,
+ *   		T const *value, void *context);
+ *   unsigned name##_upper_bound(T const *values, unsigned count,
+ *   		T const *value, void *context);
+ *   void name##_nth_element(T *values, unsigned count, unsigned nth,
+ *   		void *context);
+ *   unsigned name##_partition(T *values, unsigned count,
+ *   		int (*predicate)(void *context, T const *value), void *context);
+ *
+ * name##_sort_stable keeps equal values in their order, it needs memory for
+ * a copy of the values, returns -1 and sets sb_error to
+ * SB_ERROR_MEMORY_ALLOCATION, leaving the values unsorted, if it cannot get
+ * it, otherwise 0. name##_lower_bound and name##_upper_bound search sorted
+ * values for the first one that does not go before value, and the first one
+ * value goes before, returning count if there is none. name##_nth_element
+ * puts the value that goes at nth when sorted there, with none after it
+ * going before it and none before it going after it. name##_partition moves
+ * the values predicate accepts to the front, in no particular order, and
+ * returns how many there are.
+ */
+#define SB_SORT_DECLARE(name, T, less) \
+__songbird_sort__ \
+void __##name##_swap(T *a, T *b) { \
+	T swap = *a; \
+	*a = *b; \
+	*b = swap; \
+} \
+\
+__songbird_sort__ \
+void __##name##_insertion(T *values, unsigned count, void *context) { \
+	unsigned i, j; \
+	T value; \
+	(void)context; \
+	for(i = 1; i < count; ++i) { \
+		if(!less(context, &values[i], &values[i - 1])) { \
+			continue; \
+		} \
+		value = values[i]; \
+		j = i; \
+		do { \
+			values[j] = values[j - 1]; \
+			--j; \
+		} while(j > 0 && less(context, &value, &values[j - 1])); \
+		values[j] = value; \
+	} \
+} \
+\
+/* insertion sorts unless that takes too many moves, returns 1 if it sorted */ \
+__songbird_sort__ \
+int __##name##_partial_insertion(T *values, unsigned count, void *context) { \
+	unsigned i, j, moves = 0; \
+	T value; \
+	(void)context; \
+	for(i = 1; i < count; ++i) { \
+		if(!less(context, &values[i], &values[i - 1])) { \
+			continue; \
+		} \
+		value = values[i]; \
+		j = i; \
+		do { \
+			values[j] = values[j - 1]; \
+			--j; \
+		} while(j > 0 && less(context, &value, &values[j - 1])); \
+		values[j] = value; \
+		moves += i - j; \
+		if(moves > SB_SORT_PARTIAL_LIMIT) { \
+			return 0; \
+		} \
+	} \
+	return 1; \
+} \
+\
+__songbird_sort__ \
+void __##name##_sift(T *values, unsigned index, unsigned count, \
+		void *context) { \
+	unsigned child; \
+	T value = values[index]; \
+	(void)context; \
+	while((child = index * 2 + 1) < count) { \
+		if(child + 1 < count \
+				&& less(context, &values[child], &values[child + 1])) { \
+			++child; \
+		} \
+		if(!less(context, &value, &values[child])) { \
+			break; \
+		} \
+		values[index] = values[child]; \
+		index = child; \
+	} \
+	values[index] = value; \
+} \
+\
+__songbird_sort__ \
+void __##name##_heapsort(T *values, unsigned count, void *context) { \
+	unsigned i; \
+	for(i = count / 2; i-- > 0;) { \
+		__##name##_sift(values, i, count, context); \
+	} \
+	for(i = count; i-- > 1;) { \
+		__##name##_swap(&values[0], &values[i]); \
+		__##name##_sift(values, 0, i, context); \
+	} \
+} \
+\
+/* orders the three values so the median is at b */ \
+__songbird_sort__ \
+void __##name##_sort3(T *a, T *b, T *c, void *context) { \
+	(void)context; \
+	if(less(context, b, a)) { \
+		__##name##_swap(a, b); \
+	} \
+	if(less(context, c, b)) { \
+		__##name##_swap(b, c); \
+		if(less(context, b, a)) { \
+			__##name##_swap(a, b); \
+		} \
+	} \
+} \
+\
+/* moves the median of three, or of nine for long ranges, to values[0] */ \
+__songbird_sort__ \
+void __##name##_choose(T *values, unsigned count, void *context) { \
+	unsigned half = count / 2, eighth = count / 8; \
+	if(count >= SB_SORT_NINTHER_LIMIT) { \
+		__##name##_sort3(&values[0], &values[eighth], &values[eighth * 2], \
+				context); \
+		__##name##_sort3(&values[half - eighth], &values[half], \
+				&values[half + eighth], context); \
+		__##name##_sort3(&values[count - 1 - eighth * 2], \
+				&values[count - 1 - eighth], &values[count - 1], context); \
+		__##name##_sort3(&values[eighth], &values[half], \
+				&values[count - 1 - eighth], context); \
+	} else { \
+		__##name##_sort3(&values[0], &values[half], &values[count - 1], \
+				context); \
+	} \
+	__##name##_swap(&values[0], &values[half]); \
+} \
+\
+/* \
+ * Partitions around the pivot at values[0], returning its final place. \
+ * Scans stop on values equal to the pivot from both sides, so runs of \
+ * equal values split evenly. moved is set if any value was swapped. \
+ */ \
+__songbird_sort__ \
+unsigned __##name##_partition_right(T *values, unsigned count, int *moved, \
+		void *context) { \
+	unsigned i = 0, j = count; \
+	(void)context; \
+	*moved = 0; \
+	for(;;) { \
+		while(++i < count && less(context, &values[i], &values[0])); \
+		while(less(context, &values[0], &values[--j])); \
+		if(i >= j) { \
+			break; \
+		} \
+		__##name##_swap(&values[i], &values[j]); \
+		*moved = 1; \
+	} \
+	__##name##_swap(&values[0], &values[j]); \
+	return j; \
+} \
+\
+/* \
+ * Moves the values equal to the pivot at values[0] to the front, for a \
+ * range none of which go before the pivot, and returns the place of the \
+ * last of them. Those are in their final place. \
+ */ \
+__songbird_sort__ \
+unsigned __##name##_partition_left(T *values, unsigned count, \
+		void *context) { \
+	unsigned i = 1, j = count; \
+	(void)context; \
+	for(;;) { \
+		while(i < j && !less(context, &values[0], &values[i])) { \
+			++i; \
+		} \
+		while(i < j && less(context, &values[0], &values[j - 1])) { \
+			--j; \
+		} \
+		if(i >= j) { \
+			break; \
+		} \
+		__##name##_swap(&values[i++], &values[--j]); \
+	} \
+	__##name##_swap(&values[0], &values[i - 1]); \
+	return i - 1; \
+} \
+\
+/* \
+ * leftmost is zero when values[-1] is a pivot that none of the range goes \
+ * before. A new pivot equal to it means the range starts with a run of \
+ * equal values, which is split off in one pass. \
+ */ \
+__songbird_sort__ \
+void __##name##_introsort(T *values, unsigned count, unsigned depth, \
+		int leftmost, void *context) { \
+	unsigned pivot; \
+	int moved; \
+	while(count > SB_SORT_INSERTION_LIMIT) { \
+		if(depth == 0) { \
+			__##name##_heapsort(values, count, context); \
+			return; \
+		} \
+		--depth; \
+		__##name##_choose(values, count, context); \
+		if(!leftmost && !less(context, &values[-1], &values[0])) { \
+			pivot = __##name##_partition_left(values, count, context); \
+			values += pivot + 1; \
+			count -= pivot + 1; \
+			continue; \
+		} \
+		pivot = __##name##_partition_right(values, count, &moved, context); \
+		if(!moved \
+				&& __##name##_partial_insertion(values, pivot, context) \
+				&& __##name##_partial_insertion(values + pivot + 1, \
+					count - pivot - 1, context)) { \
+			return; \
+		} \
+		/* recurse into the smaller side, so the stack stays logarithmic */ \
+		if(pivot < count - pivot) { \
+			__##name##_introsort(values, pivot, depth, leftmost, context); \
+			values += pivot + 1; \
+			count -= pivot + 1; \
+			leftmost = 0; \
+		} else { \
+			__##name##_introsort(values + pivot + 1, count - pivot - 1, \
+					depth, 0, context); \
+			count = pivot; \
+		} \
+	} \
+	__##name##_insertion(values, count, context); \
+} \
+\
+__songbird_sort__ \
+void name##_sort(T *values, unsigned count, void *context) { \
+	__##name##_introsort(values, count, __sb_sort_depth(count), 1, context); \
+} \
+\
+/* merges the sorted runs from[0, middle) and from[middle, count) into to */ \
+__songbird_sort__ \
+void __##name##_merge(T const *from, T *to, unsigned middle, unsigned count, \
+		void *context) { \
+	unsigned i = 0, j = middle, k = 0; \
+	(void)context; \
+	if(middle == count || !less(context, &from[middle], &from[middle - 1])) { \
+		memcpy(to, from, sizeof(T) * count); \
+		return; \
+	} \
+	while(i < middle && j < count) { \
+		/* the left run wins ties, which keeps the sort stable */ \
+		if(less(context, &from[j], &from[i])) { \
+			to[k++] = from[j++]; \
+		} else { \
+			to[k++] = from[i++]; \
+		} \
+	} \
+	memcpy(&to[k], &from[i], sizeof(T) * (middle - i)); \
+	k += middle - i; \
+	memcpy(&to[k], &from[j], sizeof(T) * (count - j)); \
+} \
+\
+__songbird_sort__ \
+int name##_sort_stable(T *values, unsigned count, void *context) { \
+	T *buffer; \
+	T *from = values; \
+	T *to; \
+	T *swap; \
+	unsigned i, width; \
+	for(i = 0; i < count; i += SB_SORT_RUN) { \
+		__##name##_insertion(values + i, \
+				count - i < SB_SORT_RUN ? count - i : (unsigned)SB_SORT_RUN, context); \
+	} \
+	if(count <= SB_SORT_RUN) { \
+		return 0; \
+	} \
+	buffer = (T *)sb_malloc(sizeof(T) * count); \
+	if(buffer == NULL) { \
+		sb_error = SB_ERROR_MEMORY_ALLOCATION; \
+		return -1; \
+	} \
+	to = buffer; \
+	for(width = SB_SORT_RUN; width < count; width *= 2) { \
+		for(i = 0; i < count; i += width * 2) { \
+			if(count - i <= width) { \
+				memcpy(&to[i], &from[i], sizeof(T) * (count - i)); \
+			} else { \
+				__##name##_merge(&from[i], &to[i], width, \
+						count - i < width * 2 ? count - i : width * 2, context); \
+			} \
+		} \
+		swap = from; \
+		from = to; \
+		to = swap; \
+		if(width > (unsigned)-1 / 2) { \
+			break; \
+		} \
+	} \
+	if(from != values) { \
+		memcpy(values, from, sizeof(T) * count); \
+	} \
+	sb_free(buffer); \
+	return 0; \
+} \
+\
+__songbird_sort__ \
+unsigned name##_lower_bound(T const *values, unsigned count, T const *value, \
+		void *context) { \
+	unsigned first = 0, half; \
+	(void)context; \
+	while(count > 0) { \
+		half = count / 2; \
+		if(less(context, &values[first + half], value)) { \
+			first += half + 1; \
+			count -= half + 1; \
+		} else { \
+			count = half; \
+		} \
+	} \
+	return first; \
+} \
+\
+__songbird_sort__ \
+unsigned name##_upper_bound(T const *values, unsigned count, T const *value, \
+		void *context) { \
+	unsigned first = 0, half; \
+	(void)context; \
+	while(count > 0) { \
+		half = count / 2; \
+		if(!less(context, value, &values[first + half])) { \
+			first += half + 1; \
+			count -= half + 1; \
+		} else { \
+			count = half; \
+		} \
+	} \
+	return first; \
+} \
+\
+__songbird_sort__ \
+void name##_nth_element(T *values, unsigned count, unsigned nth, \
+		void *context) { \
+	unsigned depth = __sb_sort_depth(count), pivot; \
+	int moved; \
+	if(nth >= count) { \
+		return; \
+	} \
+	while(count > SB_SORT_INSERTION_LIMIT) { \
+		if(depth == 0) { \
+			__##name##_heapsort(values, count, context); \
+			return; \
+		} \
+		--depth; \
+		__##name##_choose(values, count, context); \
+		pivot = __##name##_partition_right(values, count, &moved, \
+				context); \
+		if(nth == pivot) { \
+			return; \
+		} \
+		if(nth < pivot) { \
+			count = pivot; \
+		} else { \
+			values += pivot + 1; \
+			count -= pivot + 1; \
+			nth -= pivot + 1; \
+		} \
+	} \
+	__##name##_insertion(values, count, context); \
+} \
+\
+__songbird_sort__ \
+unsigned name##_partition(T *values, unsigned count, \
+		int (*predicate)(void *context, T const *value), void *context) { \
+	unsigned i = 0, j = count; \
+	for(;;) { \
+		while(i < j && predicate(context, &values[i])) { \
+			++i; \
+		} \
+		while(i < j && !predicate(context, &values[j - 1])) { \
+			--j; \
+		} \
+		if(i >= j) { \
+			return i; \
+		} \
+		__##name##_swap(&values[i], &values[j - 1]); \
+		++i; \
+		--j; \
+	} \
+}
+
+/**
+ * Declares a radix sort for values of type T. key is the name of a function
+ * or macro
+ *
+ *   unsigned long key(T const *value);
+ *
+ * giving the integer values are sorted by, smallest first. Signed keys sort
+ * correctly when their sign bit is flipped, (unsigned long)k ^ LONG_MIN.
+ * The sort is stable and takes linear time, passing over the values once
+ * per byte of the key, skipping bytes that are the same in every key. The
+ * same declaration must not be repeated in one translation unit.
+ *
+ *   int name##_radix_sort(T *values, unsigned count);
+ *
+ * It needs memory for a copy of the values, returns -1 and sets sb_error to
+ * SB_ERROR_MEMORY_ALLOCATION, leaving the values unsorted, if it cannot get
+ * it, otherwise 0.
+ */
+#define SB_SORT_DECLARE_RADIX(name, T, key) \
+__songbird_sort__ \
+int name##_radix_sort(T *values, unsigned count) { \
+	unsigned counts[sizeof(unsigned long)][256]; \
+	unsigned byte, i, total, bucket; \
+	unsigned long k; \
+	T *buffer; \
+	T *from = values; \
+	T *to; \
+	T *swap; \
+	if(count < 2) { \
+		return 0; \
+	} \
+	buffer = (T *)sb_malloc(sizeof(T) * count); \
+	if(buffer == NULL) { \
+		sb_error = SB_ERROR_MEMORY_ALLOCATION; \
+		return -1; \
+	} \
+	to = buffer; \
+	memset(counts, 0, sizeof(counts)); \
+	/* one pass counts every byte of every key */ \
+	for(i = 0; i < count; ++i) { \
+		k = key(&values[i]); \
+		for(byte = 0; byte < sizeof(unsigned long); ++byte) { \
+			++counts[byte][(k >> (byte * 8)) & 0xff]; \
+		} \
+	} \
+	for(byte = 0; byte < sizeof(unsigned long); ++byte) { \
+		if(counts[byte][(key(&values[0]) >> (byte * 8)) & 0xff] == count) { \
+			continue; \
+		} \
+		for(total = 0, bucket = 0; bucket < 256; ++bucket) { \
+			i = counts[byte][bucket]; \
+			counts[byte][bucket] = total; \
+			total += i; \
+		} \
+		for(i = 0; i < count; ++i) { \
+			bucket = (unsigned)(key(&from[i]) >> (byte * 8)) & 0xff; \
+			to[counts[byte][bucket]++] = from[i]; \
+		} \
+		swap = from; \
+		from = to; \
+		to = swap; \
+	} \
+	if(from != values) { \
+		memcpy(values, from, sizeof(T) * count); \
+	} \
+	sb_free(buffer); \
+	return 0; \
+}
+
+/**
+ * Passes a sb_compare_f and its context through the generated functions.
+ * This structure is not designed to be used by the end user.
+ */
+struct __sb_sort_context {
+	sb_compare_f compare;
+	sb_predicate_f predicate;
+	void *context;
+};
+
+/**
+ * Orders pointers with the sb_compare_f of a __sb_sort_context. This
+ * function is not designed to be called by the end user.
+ */
+__songbird_sort__
+int __sb_sort_less(void *context, void const * const *a,
+		void const * const *b) {
+	struct __sb_sort_context *sort = (struct __sb_sort_context *)context;
+	return sort->compare(sort->context, *a, *b) < 0;
+}
+
+/**
+ * Tests pointers with the sb_predicate_f of a __sb_sort_context. This
+ * function is not designed to be called by the end user.
+ */
+__songbird_sort__
+int __sb_sort_accept(void *context, void const * const *value) {
+	struct __sb_sort_context *sort = (struct __sb_sort_context *)context;
+	return sort->predicate(sort->context, *value);
+}
+
+SB_SORT_DECLARE(__sb_sort_pointers, void const *, __sb_sort_less)
+
+/**
+ * Sorts the given pointers, equal values end up in no particular order.
+ * @param entries The pointers.
+ * @param count The number of pointers.
+ * @param compare The comparator.
+ * @param context Passed to compare.
+ */
+__songbird_sort__
+void sb_sort(void const **entries, unsigned count, sb_compare_f compare,
+		void *context) {
+	struct __sb_sort_context sort;
+	sort.compare = compare;
+	sort.context = context;
+	__sb_sort_pointers_sort(entries, count, &sort);
+}
+
+/**
+ * Sorts the given pointers, keeping equal values in their order. sb_error
+ * is set to SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
+ * @param entries The pointers.
+ * @param count The number of pointers.
+ * @param compare The comparator.
+ * @param context Passed to compare.
+ * @return 0 on success, -1 if the pointers were left unsorted.
+ */
+__songbird_sort__
+int sb_sort_stable(void const **entries, unsigned count, sb_compare_f compare,
+		void *context) {
+	struct __sb_sort_context sort;
+	sort.compare = compare;
+	sort.context = context;
+	return __sb_sort_pointers_sort_stable(entries, count, &sort);
+}
+
+/**
+ * Searches sorted pointers for the first that does not go before value.
+ * @param entries The pointers, sorted by compare.
+ * @param count The number of pointers.
+ * @param value The value searched for.
+ * @param compare The comparator.
+ * @param context Passed to compare.
+ * @return The index, or count if all go before value.
+ */
+__songbird_sort__
+unsigned sb_lower_bound(void const **entries, unsigned count,
+		void const *value, sb_compare_f compare, void *context) {
+	struct __sb_sort_context sort;
+	sort.compare = compare;
+	sort.context = context;
+	return __sb_sort_pointers_lower_bound(entries, count, &value, &sort);
+}
+
+/**
+ * Searches sorted pointers for the first that value goes before.
+ * @param entries The pointers, sorted by compare.
+ * @param count The number of pointers.
+ * @param value The value searched for.
+ * @param compare The comparator.
+ * @param context Passed to compare.
+ * @return The index, or count if value goes before none.
+ */
+__songbird_sort__
+unsigned sb_upper_bound(void const **entries, unsigned count,
+		void const *value, sb_compare_f compare, void *context) {
+	struct __sb_sort_context sort;
+	sort.compare = compare;
+	sort.context = context;
+	return __sb_sort_pointers_upper_bound(entries, count, &value, &sort);
+}
+
+/**
+ * Puts the pointer that goes at nth when sorted there, with none after it
+ * going before it and none before it going after it, in linear time on
+ * average.
+ * @param entries The pointers.
+ * @param count The number of pointers.
+ * @param nth The index, nothing is done if it is out of bounds.
+ * @param compare The comparator.
+ * @param context Passed to compare.
+ */
+__songbird_sort__
+void sb_nth_element(void const **entries, unsigned count, unsigned nth,
+		sb_compare_f compare, void *context) {
+	struct __sb_sort_context sort;
+	sort.compare = compare;
+	sort.context = context;
+	__sb_sort_pointers_nth_element(entries, count, nth, &sort);
+}
+
+/**
+ * Moves the pointers the predicate accepts to the front, in no particular
+ * order.
+ * @param entries The pointers.
+ * @param count The number of pointers.
+ * @param predicate The predicate.
+ * @param context Passed to predicate.
+ * @return The number of pointers accepted.
+ */
+__songbird_sort__
+unsigned sb_partition(void const **entries, unsigned count,
+		sb_predicate_f predicate, void *context) {
+	struct __sb_sort_context sort;
+	sort.predicate = predicate;
+	sort.context = context;
+	return __sb_sort_pointers_partition(entries, count, __sb_sort_accept,
+			&sort);
+}
+
+/*
+ * These are only available when vector.h is included before this file.
+ */
+#ifdef __SONGBIRD_VECTOR_H__
+/** sb_sort over the entries of a vector */
+__songbird_sort__
+void sb_vector_sort(sb_vector_t *vector, sb_compare_f compare, void *context) {
+	sb_sort(vector->entries, vector->size, compare, context);
+}
+
+/** sb_sort_stable over the entries of a vector */
+__songbird_sort__
+int sb_vector_sort_stable(sb_vector_t *vector, sb_compare_f compare,
+		void *context) {
+	return sb_sort_stable(vector->entries, vector->size, compare, context);
+}
+
+/** sb_lower_bound over the entries of a vector */
+__songbird_sort__
+unsigned sb_vector_lower_bound(sb_vector_t *vector, void const *value,
+		sb_compare_f compare, void *context) {
+	return sb_lower_bound(vector->entries, vector->size, value, compare,
+			context);
+}
+
+/** sb_upper_bound over the entries of a vector */
+__songbird_sort__
+unsigned sb_vector_upper_bound(sb_vector_t *vector, void const *value,
+		sb_compare_f compare, void *context) {
+	return sb_upper_bound(vector->entries, vector->size, value, compare,
+			context);
+}
+
+/** sb_nth_element over the entries of a vector */
+__songbird_sort__
+void sb_vector_nth_element(sb_vector_t *vector, unsigned nth,
+		sb_compare_f compare, void *context) {
+	sb_nth_element(vector->entries, vector->size, nth, compare, context);
+}
+
+/** sb_partition over the entries of a vector */
+__songbird_sort__
+unsigned sb_vector_partition(sb_vector_t *vector, sb_predicate_f predicate,
+		void *context) {
+	return sb_partition(vector->entries, vector->size, predicate, context);
+}
+#endif
+
+/*
+ * These are only available when array.h is included before this file.
+ */
+#ifdef __SONGBIRD_ARRAY_H__
+/** sb_sort over the entries of an array */
+__songbird_sort__
+void sb_array_sort(sb_array_t *array, sb_compare_f compare, void *context) {
+	sb_sort(array->entries, array->size, compare, context);
+}
+
+/** sb_sort_stable over the entries of an array */
+__songbird_sort__
+int sb_array_sort_stable(sb_array_t *array, sb_compare_f compare,
+		void *context) {
+	return sb_sort_stable(array->entries, array->size, compare, context);
+}
+
+/** sb_lower_bound over the entries of an array */
+__songbird_sort__
+unsigned sb_array_lower_bound(sb_array_t *array, void const *value,
+		sb_compare_f compare, void *context) {
+	return sb_lower_bound(array->entries, array->size, value, compare,
+			context);
+}
+
+/** sb_upper_bound over the entries of an array */
+__songbird_sort__
+unsigned sb_array_upper_bound(sb_array_t *array, void const *value,
+		sb_compare_f compare, void *context) {
+	return sb_upper_bound(array->entries, array->size, value, compare,
+			context);
+}
+
+/** sb_nth_element over the entries of an array */
+__songbird_sort__
+void sb_array_nth_element(sb_array_t *array, unsigned nth,
+		sb_compare_f compare, void *context) {
+	sb_nth_element(array->entries, array->size, nth, compare, context);
+}
+
+/** sb_partition over the entries of an array */
+__songbird_sort__
+unsigned sb_array_partition(sb_array_t *array, sb_predicate_f predicate,
+		void *context) {
+	return sb_partition(array->entries, array->size, predicate, context);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * __songbird_sort__ stays defined, the functions SB_SORT_DECLARE and
+ * SB_SORT_DECLARE_RADIX produce are expanded after this point.
+ */
+
+#endif /* __SONGBIRD_SORT_H__ */
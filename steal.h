@@ -0,0 +1,410 @@
+/**
+ * Copyright (c) 2014-2017 Robert Maupin <chasesan@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SONGBIRD_STEAL_H__
+#define __SONGBIRD_STEAL_H__
+
+#ifndef __SB_NO_ALLOC__
+#include <stdlib.h>
+#define sb_malloc malloc
+#define sb_realloc realloc
+#define sb_free free
+#endif /* __SB_NO_ALLOC__ */
+
+#ifndef __SB_ALLOCATOR__
+#define __SB_ALLOCATOR__
+#include <stddef.h>
+/*
+ * A runtime allocator, handed to a container when it is initialized. A NULL
+ * allocator stands for sb_malloc, sb_realloc and sb_free. The allocator has
+ * to outlive every container using it and release has to accept NULL.
+ * alloc.h provides arena and pool allocators.
+ */
+typedef struct sb_allocator {
+	void *(*alloc)(void *context, size_t size);
+	void *(*resize)(void *context, void *ptr, size_t size);
+	void (*release)(void *context, void *ptr);
+	void *context;
+} sb_allocator_t;
+#define __sb_allocate(a, size) \
+	((a) ? (a)->alloc((a)->context, (size)) : sb_malloc(size))
+#define __sb_reallocate(a, ptr, size) \
+	((a) ? (a)->resize((a)->context, (ptr), (size)) : sb_realloc((ptr), (size)))
+#define __sb_deallocate(a, ptr) \
+	((a) ? (a)->release((a)->context, (ptr)) : sb_free(ptr))
+#endif
+
+#include <string.h>
+
+#ifdef __cplusplus
+/* Not sure why you would want to use this in C++, but just in case. */
+extern "C" {
+#define __songbird_header__	inline
+/* Works even if __STDC_VERSION__ is not defined. */
+#elif __STDC_VERSION__ <= 199409L
+#define __songbird_header__	static __inline__
+#else
+#define __songbird_header__	static inline
+#endif
+
+#ifndef __SB_ERROR__
+#define __SB_ERROR__
+enum {
+	SB_ERROR_NONE = 0,
+	SB_ERROR_MEMORY_ALLOCATION = 1,
+	SB_ERROR_OUT_OF_BOUNDS = 2,
+};
+#if __STDC_VERSION__ >= 201112L && !defined __STDC_NO_THREADS__
+__thread int sb_error = SB_ERROR_NONE;
+#else
+int sb_error = SB_ERROR_NONE;
+#endif
+#define sb_error() (sb_error)
+#define sb_error_clear() (sb_error = SB_ERROR_NONE)
+#endif
+
+#ifndef __SB_ATOMIC__
+#define __SB_ATOMIC__
+/*
+ * The C11 memory model on plain integers and pointers. GCC and Clang provide
+ * it in any language mode, other compilers need C11 atomics.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define __sb_atomic_t(T) T
+#define __sb_atomic_load(p, o) __atomic_load_n((p), __ATOMIC_##o)
+#define __sb_atomic_store(p, v, o) __atomic_store_n((p), (v), __ATOMIC_##o)
+#define __sb_atomic_add(p, v, o) __atomic_fetch_add((p), (v), __ATOMIC_##o)
+#define __sb_atomic_cas(p, e, d, o) \
+	__atomic_compare_exchange_n((p), (e), (d), 0, __ATOMIC_##o, __ATOMIC_RELAXED)
+#define __sb_atomic_fence(o) __atomic_thread_fence(__ATOMIC_##o)
+#elif __STDC_VERSION__ >= 201112L && !defined __STDC_NO_ATOMICS__
+#include <stdatomic.h>
+#define __SB_MO_RELAXED memory_order_relaxed
+#define __SB_MO_ACQUIRE memory_order_acquire
+#define __SB_MO_RELEASE memory_order_release
+#define __SB_MO_ACQ_REL memory_order_acq_rel
+#define __SB_MO_SEQ_CST memory_order_seq_cst
+#define __sb_atomic_t(T) _Atomic T
+#define __sb_atomic_load(p, o) atomic_load_explicit((p), __SB_MO_##o)
+#define __sb_atomic_store(p, v, o) atomic_store_explicit((p), (v), __SB_MO_##o)
+#define __sb_atomic_add(p, v, o) atomic_fetch_add_explicit((p), (v), __SB_MO_##o)
+#define __sb_atomic_cas(p, e, d, o) atomic_compare_exchange_strong_explicit( \
+	(p), (e), (d), __SB_MO_##o, memory_order_relaxed)
+#define __sb_atomic_fence(o) atomic_thread_fence(__SB_MO_##o)
+#else
+#error "Songbird needs GCC/Clang atomic builtins or C11 atomics."
+#endif
+enum {
+	/* fields written by different threads are kept this far apart */
+	SB_CACHE_LINE = 64
+};
+#endif
+
+#include <stddef.h>
+
+enum {
+	SB_STEAL_DEFAULT_CAPACITY = 256
+};
+
+/*
+ * A Chase-Lev work stealing deque. The owner thread pushes and pops at the
+ * back like a stack, other threads steal from the front with a compare and
+ * swap, so the owner only synchronizes with thieves when one element is
+ * left. When the owner fills the ring it grows into a larger one without
+ * stopping the thieves, the old rings stay readable until the deque is
+ * freed. Follows "Correct and Efficient Work-Stealing for Weak Memory
+ * Models" by Le, Pop, Cohen and Zappa Nardelli.
+ */
+
+typedef void const *__sb_steal_value_t;
+
+struct __sb_steal_ring {
+	size_t capacity;
+	/* the previous, smaller ring, kept alive for thieves still reading it */
+	struct __sb_steal_ring *retired;
+	__sb_atomic_t(__sb_steal_value_t) entries[1];
+};
+
+typedef struct __sb_steal_ring *__sb_steal_ring_t;
+
+/**
+ * @brief The work stealing deque structure.
+ * This is the structure used by the sb_steal_* functions.
+ * It is highly recommended you do not change any values in this
+ * structure manually.
+ */
+typedef struct sb_steal {
+	__sb_atomic_t(size_t) front;
+	char __pad0[SB_CACHE_LINE - sizeof(size_t)];
+	__sb_atomic_t(size_t) back;
+	__sb_atomic_t(__sb_steal_ring_t) ring;
+	sb_allocator_t const *allocator;
+	char __pad1[SB_CACHE_LINE];
+} sb_steal_t;
+
+/**
+ * Initializes the specified deque. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
+ * @param deque The deque to initialize.
+ * @param capacity The initial capacity of the deque, if 0 it defaults to 256
+ * 		(the SB_STEAL_DEFAULT_CAPACITY). It is rounded up to a power of two.
+ */
+__songbird_header__
+void sb_steal_init(sb_steal_t *deque, unsigned capacity);
+
+/**
+ * Initializes the specified deque, taking its memory from the given
+ * allocator. sb_error is set to SB_ERROR_MEMORY_ALLOCATION if the memory
+ * allocation fails.
+ * @param deque The deque to initialize.
+ * @param capacity The initial capacity of the deque, as for sb_steal_init.
+ * @param allocator The allocator, or NULL for sb_malloc. It is used from the
+ * 		owner thread only.
+ */
+__songbird_header__
+void sb_steal_init_alloc(sb_steal_t *deque, unsigned capacity,
+	sb_allocator_t const *allocator);
+
+/**
+ * Frees all allocated memory for the given deque. No thread may use the
+ * deque any more.
+ * @param deque The deque to free.
+ */
+__songbird_header__
+void sb_steal_free(sb_steal_t *deque);
+
+/**
+ * Determines the number of values in the deque. With thieves at work the
+ * result may already be out of date.
+ * @param deque The deque.
+ * @return The current number of values in the deque.
+ */
+__songbird_header__
+unsigned sb_steal_size(sb_steal_t *deque);
+
+/**
+ * Pushes the given value to the back of the deque, growing it as needed.
+ * Only the owner thread may call this. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation during expansion
+ * fails.
+ * @param deque The deque.
+ * @param value The value to push.
+ * @return 1 if the value was pushed, 0 if the deque could not grow.
+ */
+__songbird_header__
+int sb_steal_push(sb_steal_t *deque, void const *value);
+
+/**
+ * Pops the value at the back of the deque, the one pushed last. Only the
+ * owner thread may call this.
+ * @param deque The deque.
+ * @return The value at the back of the deque, or NULL if it is empty.
+ */
+__songbird_header__
+void const *sb_steal_pop(sb_steal_t *deque);
+
+/**
+ * Steals the value at the front of the deque, the oldest one. Any thread
+ * may call this.
+ * @param deque The deque.
+ * @return The value at the front of the deque, or NULL if it is empty.
+ */
+__songbird_header__
+void const *sb_steal_steal(sb_steal_t *deque);
+
+/* function definitions */
+
+/**
+ * Allocates a ring of the given capacity. This function is not designed to
+ * be called by the end user.
+ */
+__songbird_header__
+struct __sb_steal_ring *__sb_steal_ring_alloc(sb_steal_t *deque,
+		size_t capacity) {
+	struct __sb_steal_ring *ring;
+	if(capacity > ((size_t)-1 - sizeof(struct __sb_steal_ring))
+			/ sizeof(__sb_steal_value_t)) {
+		return NULL;
+	}
+	ring = (struct __sb_steal_ring *)__sb_allocate(deque->allocator,
+			sizeof(struct __sb_steal_ring)
+			+ sizeof(__sb_steal_value_t) * (capacity - 1));
+	if(ring == NULL) {
+		return NULL;
+	}
+	ring->capacity = capacity;
+	ring->retired = NULL;
+	return ring;
+}
+
+__songbird_header__
+void sb_steal_init(sb_steal_t *deque, unsigned capacity) {
+	sb_steal_init_alloc(deque, capacity, NULL);
+}
+
+__songbird_header__
+void sb_steal_init_alloc(sb_steal_t *deque, unsigned capacity,
+		sb_allocator_t const *allocator) {
+	unsigned n = SB_STEAL_DEFAULT_CAPACITY;
+	struct __sb_steal_ring *ring;
+	if(capacity != 0) {
+		for(n = 2; n < capacity && n * 2 > n; n *= 2);
+	}
+	deque->allocator = allocator;
+	ring = __sb_steal_ring_alloc(deque, n);
+	if(ring == NULL) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+	}
+	__sb_atomic_store(&deque->front, 0, RELAXED);
+	__sb_atomic_store(&deque->back, 0, RELAXED);
+	__sb_atomic_store(&deque->ring, ring, RELEASE);
+}
+
+__songbird_header__
+void sb_steal_free(sb_steal_t *deque) {
+	struct __sb_steal_ring *ring;
+	if(!deque) {
+		return;
+	}
+	ring = __sb_atomic_load(&deque->ring, RELAXED);
+	while(ring != NULL) {
+		struct __sb_steal_ring *retired = ring->retired;
+		__sb_deallocate(deque->allocator, ring);
+		ring = retired;
+	}
+	__sb_atomic_store(&deque->ring, NULL, RELAXED);
+}
+
+__songbird_header__
+unsigned sb_steal_size(sb_steal_t *deque) {
+	size_t front = __sb_atomic_load(&deque->front, ACQUIRE);
+	size_t back = __sb_atomic_load(&deque->back, ACQUIRE);
+	/* the indices run freely, the difference is negative while a pop and a
+	 * steal race for the last value */
+	return (ptrdiff_t)(back - front) > 0 ? (unsigned)(back - front) : 0;
+}
+
+/**
+ * Moves the values between front and back into a ring twice the size and
+ * publishes it. Thieves that still hold the old ring read the same values
+ * from it. This function is not designed to be called by the end user.
+ */
+__songbird_header__
+struct __sb_steal_ring *__sb_steal_grow(sb_steal_t *deque,
+		struct __sb_steal_ring *ring, size_t front, size_t back) {
+	struct __sb_steal_ring *bigger;
+	size_t i;
+	if(ring->capacity * 2 < ring->capacity) {
+		return NULL;
+	}
+	bigger = __sb_steal_ring_alloc(deque, ring->capacity * 2);
+	if(bigger == NULL) {
+		return NULL;
+	}
+	for(i = front; i != back; ++i) {
+		__sb_atomic_store(&bigger->entries[i & (bigger->capacity - 1)],
+				__sb_atomic_load(&ring->entries[i & (ring->capacity - 1)], RELAXED),
+				RELAXED);
+	}
+	bigger->retired = ring;
+	__sb_atomic_store(&deque->ring, bigger, RELEASE);
+	return bigger;
+}
+
+__songbird_header__
+int sb_steal_push(sb_steal_t *deque, void const *value) {
+	size_t back = __sb_atomic_load(&deque->back, RELAXED);
+	size_t front = __sb_atomic_load(&deque->front, ACQUIRE);
+	struct __sb_steal_ring *ring = __sb_atomic_load(&deque->ring, RELAXED);
+	if(ring == NULL) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return 0;
+	}
+	if(back - front >= ring->capacity) {
+		ring = __sb_steal_grow(deque, ring, front, back);
+		if(ring == NULL) {
+			sb_error = SB_ERROR_MEMORY_ALLOCATION;
+			return 0;
+		}
+	}
+	__sb_atomic_store(&ring->entries[back & (ring->capacity - 1)], value, RELAXED);
+	/* publishes the value, and what it points at, to the thieves */
+	__sb_atomic_store(&deque->back, back + 1, RELEASE);
+	return 1;
+}
+
+__songbird_header__
+void const *sb_steal_pop(sb_steal_t *deque) {
+	size_t back = __sb_atomic_load(&deque->back, RELAXED) - 1;
+	struct __sb_steal_ring *ring = __sb_atomic_load(&deque->ring, RELAXED);
+	size_t front;
+	void const *value = NULL;
+	if(ring == NULL) {
+		return NULL;
+	}
+	/* take the slot first, then look whether a thief got there too */
+	__sb_atomic_store(&deque->back, back, RELAXED);
+	__sb_atomic_fence(SEQ_CST);
+	front = __sb_atomic_load(&deque->front, RELAXED);
+	if((ptrdiff_t)(back - front) >= 0) {
+		value = __sb_atomic_load(&ring->entries[back & (ring->capacity - 1)], RELAXED);
+		if(back == front) {
+			/* the last value, race the thieves for it */
+			if(!__sb_atomic_cas(&deque->front, &front, front + 1, SEQ_CST)) {
+				value = NULL;
+			}
+			__sb_atomic_store(&deque->back, back + 1, RELAXED);
+		}
+	} else {
+		__sb_atomic_store(&deque->back, back + 1, RELAXED);
+	}
+	return value;
+}
+
+__songbird_header__
+void const *sb_steal_steal(sb_steal_t *deque) {
+	size_t front, back;
+	struct __sb_steal_ring *ring;
+	void const *value;
+	for(;;) {
+		front = __sb_atomic_load(&deque->front, ACQUIRE);
+		__sb_atomic_fence(SEQ_CST);
+		back = __sb_atomic_load(&deque->back, ACQUIRE);
+		if((ptrdiff_t)(back - front) <= 0) {
+			return NULL;
+		}
+		ring = __sb_atomic_load(&deque->ring, ACQUIRE);
+		value = __sb_atomic_load(&ring->entries[front & (ring->capacity - 1)], RELAXED);
+		if(__sb_atomic_cas(&deque->front, &front, front + 1, SEQ_CST)) {
+			return value;
+		}
+		/* another thief or the owner took it, try the next one */
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef __songbird_header__
+
+#endif /* __SONGBIRD_STEAL_H__ */
@@ -0,0 +1,644 @@
+/**
+ * Copyright (c) 2014-2017 Robert Maupin <chasesan@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SONGBIRD_TASKS_H__
+#define __SONGBIRD_TASKS_H__
+
+/*
+ * A work stealing thread pool. Every worker owns a sb_steal_t, a loop is
+ * split in halves that go onto the deque of the worker splitting it, and
+ * idle workers steal the oldest, largest halves from the others, so uneven
+ * chunks still keep every core busy. Needs steal.h next to it. POSIX only,
+ * link with -pthread.
+ */
+
+#include "steal.h"
+
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifndef __SB_NO_ALLOC__
+#include <stdlib.h>
+#define sb_malloc malloc
+#define sb_realloc realloc
+#define sb_free free
+#endif /* __SB_NO_ALLOC__ */
+
+#ifdef __cplusplus
+/* Not sure why you would want to use this in C++, but just in case. */
+extern "C" {
+#define __songbird_header__	inline
+/* Works even if __STDC_VERSION__ is not defined. */
+#elif __STDC_VERSION__ <= 199409L
+#define __songbird_header__	static __inline__
+#else
+#define __songbird_header__	static inline
+#endif
+
+enum {
+	/* a loop without a grain size is cut into this many chunks per worker */
+	SB_TASKS_CHUNKS_PER_WORKER = 8,
+	/* steal attempts an idle worker makes before it goes to sleep */
+	SB_TASKS_SPIN = 64
+};
+
+/** runs the loop body for the indices begin up to but not including end */
+typedef void (*sb_tasks_range_f)(void *context, unsigned begin, unsigned end);
+/** reduces the indices begin up to end into partial */
+typedef void (*sb_tasks_reduce_f)(void *context, unsigned begin, unsigned end, void *partial);
+/** merges partial into into, partials arrive in index order */
+typedef void (*sb_tasks_combine_f)(void *context, void *into, void const *partial);
+/** called for every value of a container with its index */
+typedef void (*sb_tasks_each_f)(void *context, void const *value, unsigned index);
+/** returns the value that replaces the given one */
+typedef void const *(*sb_tasks_map_f)(void *context, void const *value, unsigned index);
+/** reduces count consecutive entries of a container into partial */
+typedef void (*sb_tasks_fold_f)(void *context, void const **entries, unsigned count, void *partial);
+
+struct __sb_tasks_job;
+
+struct __sb_tasks_task {
+	struct __sb_tasks_job *job;
+	unsigned begin;
+	unsigned end;
+	/* links tasks handed in from outside the pool */
+	struct __sb_tasks_task *next;
+};
+
+struct __sb_tasks_worker {
+	sb_steal_t deque;
+	pthread_t thread;
+	struct sb_tasks *tasks;
+	unsigned index;
+	unsigned seed;
+};
+
+/**
+ * @brief The thread pool structure.
+ * This is the structure used by the sb_tasks_* functions.
+ * It is highly recommended you do not change any values in this
+ * structure manually.
+ */
+typedef struct sb_tasks {
+	unsigned const count;
+	struct __sb_tasks_worker *workers;
+	pthread_mutex_t lock;
+	/* idle workers wait on wake, callers of a loop on done */
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	struct __sb_tasks_task *injected;
+	__sb_atomic_t(unsigned) sleeping;
+	int stop;
+} sb_tasks_t;
+
+/**
+ * Starts the given number of worker threads.
+ * @param tasks The pool to initialize.
+ * @param threads The number of workers, if 0 one per online processor.
+ * @return 0 on success, -1 if the threads or their memory could not be had.
+ */
+__songbird_header__
+int sb_tasks_init(sb_tasks_t *tasks, unsigned threads);
+
+/**
+ * Stops and joins the workers and frees all memory of the pool. No loop may
+ * be running on it.
+ * @param tasks The pool to free.
+ */
+__songbird_header__
+void sb_tasks_free(sb_tasks_t *tasks);
+
+/**
+ * Runs range over the indices 0 up to count on the pool and returns once
+ * all of them are done. The indices are cut into chunks of grain and range
+ * usually gets one chunk per call, but it may get several neighbouring
+ * chunks in one call, all of them when the pool has no workers or memory
+ * runs short. Must not be called from inside a task.
+ * @param tasks The pool.
+ * @param count The number of indices.
+ * @param grain The number of indices per chunk, if 0 it is picked so every
+ * 		worker gets about 8 (SB_TASKS_CHUNKS_PER_WORKER) chunks.
+ * @param range The loop body.
+ * @param context Passed to range.
+ */
+__songbird_header__
+void sb_tasks_parallel_for(sb_tasks_t *tasks, unsigned count, unsigned grain,
+	sb_tasks_range_f range, void *context);
+
+/**
+ * Reduces the indices 0 up to count in parallel. Every chunk starts from a
+ * copy of result, which has to hold the identity of the reduction, is
+ * reduced by reduce, and the partial results are then combined into result
+ * in index order on the calling thread, so combine only has to be
+ * associative.
+ * @param tasks The pool.
+ * @param count The number of indices.
+ * @param grain The number of indices per chunk, as for sb_tasks_parallel_for.
+ * @param result The identity on entry, the result on return.
+ * @param size The size of result.
+ * @param reduce Reduces one chunk.
+ * @param combine Merges a partial result into result.
+ * @param context Passed to reduce and combine.
+ * @return 0 on success, -1 if the memory for the partial results could not
+ * 		be allocated, result is left as it was.
+ */
+__songbird_header__
+int sb_tasks_parallel_reduce(sb_tasks_t *tasks, unsigned count,
+	unsigned grain, void *result, size_t size, sb_tasks_reduce_f reduce,
+	sb_tasks_combine_f combine, void *context);
+
+/* function definitions */
+
+struct __sb_tasks_job {
+	sb_tasks_range_f range;
+	void *context;
+	unsigned grain;
+	/* every split takes the next of these, there is one per chunk */
+	struct __sb_tasks_task *pieces;
+	__sb_atomic_t(unsigned) next;
+	/* indices not yet run, the job is done at 0 */
+	__sb_atomic_t(unsigned) remaining;
+};
+
+/**
+ * Wakes one idle worker after work was pushed, if any are asleep. This
+ * function is not designed to be called by the end user.
+ */
+__songbird_header__
+void __sb_tasks_notify(sb_tasks_t *tasks) {
+	/* pairs with the fence in __sb_tasks_idle */
+	__sb_atomic_fence(SEQ_CST);
+	if(__sb_atomic_load(&tasks->sleeping, RELAXED) > 0) {
+		pthread_mutex_lock(&tasks->lock);
+		pthread_cond_signal(&tasks->wake);
+		pthread_mutex_unlock(&tasks->lock);
+	}
+}
+
+/**
+ * Runs a piece of a loop, first splitting off the upper halves onto the
+ * deque of the worker for others to steal until only one chunk is left.
+ * This function is not designed to be called by the end user.
+ */
+__songbird_header__
+void __sb_tasks_run(struct __sb_tasks_worker *worker,
+		struct __sb_tasks_task *task) {
+	struct __sb_tasks_job *job = task->job;
+	unsigned begin = task->begin;
+	unsigned end = task->end;
+	unsigned chunks;
+	struct __sb_tasks_task *half;
+	while(end - begin > job->grain) {
+		chunks = (end - begin - 1) / job->grain + 1;
+		half = &job->pieces[__sb_atomic_add(&job->next, 1, RELAXED)];
+		half->job = job;
+		half->begin = begin + chunks / 2 * job->grain;
+		half->end = end;
+		if(!sb_steal_push(&worker->deque, half)) {
+			break; /* no room to split, run the rest here */
+		}
+		__sb_tasks_notify(worker->tasks);
+		end = half->begin;
+	}
+	job->range(job->context, begin, end);
+	if(__sb_atomic_add(&job->remaining, 0u - (end - begin), ACQ_REL)
+			== end - begin) {
+		pthread_mutex_lock(&worker->tasks->lock);
+		pthread_cond_broadcast(&worker->tasks->done);
+		pthread_mutex_unlock(&worker->tasks->lock);
+	}
+}
+
+/**
+ * Looks for work in the deques of the other workers, starting at a random
+ * one. This function is not designed to be called by the end user.
+ */
+__songbird_header__
+struct __sb_tasks_task *__sb_tasks_steal(struct __sb_tasks_worker *worker) {
+	sb_tasks_t *tasks = worker->tasks;
+	struct __sb_tasks_task *task;
+	unsigned i, victim;
+	/* xorshift, good enough to spread the thieves */
+	worker->seed ^= worker->seed << 13;
+	worker->seed ^= worker->seed >> 17;
+	worker->seed ^= worker->seed << 5;
+	for(i = 0; i < tasks->count; ++i) {
+		victim = (worker->seed + i) % tasks->count;
+		if(victim == worker->index) {
+			continue;
+		}
+		task = (struct __sb_tasks_task *)sb_steal_steal(&tasks->workers[victim].deque);
+		if(task != NULL) {
+			return task;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Takes a task handed in from outside, or sleeps until there is work. Must
+ * be called with the lock held. This function is not designed to be called
+ * by the end user.
+ */
+__songbird_header__
+struct __sb_tasks_task *__sb_tasks_idle(struct __sb_tasks_worker *worker) {
+	sb_tasks_t *tasks = worker->tasks;
+	struct __sb_tasks_task *task;
+	unsigned i;
+	for(;;) {
+		if(tasks->injected != NULL) {
+			task = tasks->injected;
+			tasks->injected = task->next;
+			return task;
+		}
+		if(tasks->stop) {
+			return NULL;
+		}
+		/* anyone pushing after this sees us asleep and signals */
+		__sb_atomic_add(&tasks->sleeping, 1, RELAXED);
+		__sb_atomic_fence(SEQ_CST);
+		for(i = 0; i < tasks->count; ++i) {
+			if(sb_steal_size(&tasks->workers[i].deque) > 0) {
+				break;
+			}
+		}
+		if(i == tasks->count) {
+			pthread_cond_wait(&tasks->wake, &tasks->lock);
+		}
+		__sb_atomic_add(&tasks->sleeping, (unsigned)-1, RELAXED);
+		if(i < tasks->count) {
+			return NULL; /* go steal it */
+		}
+	}
+}
+
+/**
+ * The loop of every worker thread. This function is not designed to be
+ * called by the end user.
+ */
+__songbird_header__
+void *__sb_tasks_worker(void *data) {
+	struct __sb_tasks_worker *worker = (struct __sb_tasks_worker *)data;
+	sb_tasks_t *tasks = worker->tasks;
+	struct __sb_tasks_task *task;
+	int spin;
+	for(;;) {
+		task = (struct __sb_tasks_task *)sb_steal_pop(&worker->deque);
+		for(spin = 0; task == NULL && spin < SB_TASKS_SPIN; ++spin) {
+			task = __sb_tasks_steal(worker);
+		}
+		if(task == NULL) {
+			pthread_mutex_lock(&tasks->lock);
+			task = __sb_tasks_idle(worker);
+			if(task == NULL && tasks->stop) {
+				pthread_mutex_unlock(&tasks->lock);
+				return NULL;
+			}
+			pthread_mutex_unlock(&tasks->lock);
+		}
+		if(task != NULL) {
+			__sb_tasks_run(worker, task);
+		}
+	}
+}
+
+__songbird_header__
+int sb_tasks_init(sb_tasks_t *tasks, unsigned threads) {
+	unsigned i;
+	if(threads == 0) {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = online > 0 ? (unsigned)online : 1;
+	}
+	*(unsigned *)&tasks->count = 0;
+	tasks->injected = NULL;
+	tasks->stop = 0;
+	__sb_atomic_store(&tasks->sleeping, 0, RELAXED);
+	tasks->workers = (struct __sb_tasks_worker *)sb_malloc(
+			sizeof(struct __sb_tasks_worker) * threads);
+	if(tasks->workers == NULL) {
+		return -1;
+	}
+	pthread_mutex_init(&tasks->lock, NULL);
+	pthread_cond_init(&tasks->wake, NULL);
+	pthread_cond_init(&tasks->done, NULL);
+	for(i = 0; i < threads; ++i) {
+		sb_steal_init(&tasks->workers[i].deque, 0);
+		tasks->workers[i].tasks = tasks;
+		tasks->workers[i].index = i;
+		tasks->workers[i].seed = 2463534242u + i * 2654435761u;
+	}
+	*(unsigned *)&tasks->count = threads;
+	for(i = 0; i < threads; ++i) {
+		if(pthread_create(&tasks->workers[i].thread, NULL, __sb_tasks_worker,
+				&tasks->workers[i])) {
+			break;
+		}
+	}
+	if(i < threads) {
+		/* stop the ones that did start, sb_tasks_free joins them */
+		unsigned started = i;
+		for(; i < threads; ++i) {
+			sb_steal_free(&tasks->workers[i].deque);
+		}
+		*(unsigned *)&tasks->count = started;
+		sb_tasks_free(tasks);
+		return -1;
+	}
+	return 0;
+}
+
+__songbird_header__
+void sb_tasks_free(sb_tasks_t *tasks) {
+	unsigned i;
+	pthread_mutex_lock(&tasks->lock);
+	tasks->stop = 1;
+	pthread_cond_broadcast(&tasks->wake);
+	pthread_mutex_unlock(&tasks->lock);
+	for(i = 0; i < tasks->count; ++i) {
+		pthread_join(tasks->workers[i].thread, NULL);
+	}
+	for(i = 0; tasks->workers && i < tasks->count; ++i) {
+		sb_steal_free(&tasks->workers[i].deque);
+	}
+	pthread_cond_destroy(&tasks->done);
+	pthread_cond_destroy(&tasks->wake);
+	pthread_mutex_destroy(&tasks->lock);
+	sb_free(tasks->workers);
+	tasks->workers = NULL;
+	*(unsigned *)&tasks->count = 0;
+}
+
+__songbird_header__
+void sb_tasks_parallel_for(sb_tasks_t *tasks, unsigned count, unsigned grain,
+		sb_tasks_range_f range, void *context) {
+	struct __sb_tasks_job job;
+	unsigned chunks;
+	if(count == 0) {
+		return;
+	}
+	if(grain == 0) {
+		grain = count / ((tasks->count ? tasks->count : 1) * SB_TASKS_CHUNKS_PER_WORKER);
+		if(grain == 0) {
+			grain = 1;
+		}
+	}
+	chunks = (count - 1) / grain + 1;
+	if(chunks == 1 || tasks->count == 0) {
+		range(context, 0, count);
+		return;
+	}
+	job.range = range;
+	job.context = context;
+	job.grain = grain;
+	job.pieces = (struct __sb_tasks_task *)sb_malloc(sizeof(struct __sb_tasks_task) * chunks);
+	if(job.pieces == NULL) {
+		/* still correct, just on one core */
+		range(context, 0, count);
+		return;
+	}
+	__sb_atomic_store(&job.next, 1, RELAXED);
+	__sb_atomic_store(&job.remaining, count, RELAXED);
+	job.pieces[0].job = &job;
+	job.pieces[0].begin = 0;
+	job.pieces[0].end = count;
+	pthread_mutex_lock(&tasks->lock);
+	job.pieces[0].next = tasks->injected;
+	tasks->injected = &job.pieces[0];
+	pthread_cond_signal(&tasks->wake);
+	while(__sb_atomic_load(&job.remaining, ACQUIRE) != 0) {
+		pthread_cond_wait(&tasks->done, &tasks->lock);
+	}
+	pthread_mutex_unlock(&tasks->lock);
+	sb_free(job.pieces);
+}
+
+struct __sb_tasks_reduction {
+	sb_tasks_reduce_f reduce;
+	void *context;
+	unsigned char *partials;
+	size_t size;
+	unsigned grain;
+};
+
+__songbird_header__
+void __sb_tasks_reduce_range(void *context, unsigned begin, unsigned end) {
+	struct __sb_tasks_reduction *reduction = (struct __sb_tasks_reduction *)context;
+	reduction->reduce(reduction->context, begin, end,
+			reduction->partials + (size_t)(begin / reduction->grain) * reduction->size);
+}
+
+__songbird_header__
+int sb_tasks_parallel_reduce(sb_tasks_t *tasks, unsigned count,
+		unsigned grain, void *result, size_t size, sb_tasks_reduce_f reduce,
+		sb_tasks_combine_f combine, void *context) {
+	struct __sb_tasks_reduction reduction;
+	unsigned chunks, i;
+	if(count == 0) {
+		return 0;
+	}
+	if(grain == 0) {
+		grain = count / ((tasks->count ? tasks->count : 1) * SB_TASKS_CHUNKS_PER_WORKER);
+		if(grain == 0) {
+			grain = 1;
+		}
+	}
+	chunks = (count - 1) / grain + 1;
+	reduction.partials = (unsigned char *)sb_malloc(size * chunks);
+	if(reduction.partials == NULL) {
+		return -1;
+	}
+	for(i = 0; i < chunks; ++i) {
+		memcpy(reduction.partials + (size_t)i * size, result, size);
+	}
+	reduction.reduce = reduce;
+	reduction.context = context;
+	reduction.size = size;
+	reduction.grain = grain;
+	sb_tasks_parallel_for(tasks, count, grain, __sb_tasks_reduce_range, &reduction);
+	for(i = 0; i < chunks; ++i) {
+		combine(context, result, reduction.partials + (size_t)i * size);
+	}
+	sb_free(reduction.partials);
+	return 0;
+}
+
+#ifdef __SONGBIRD_VECTOR_H__
+/*
+ * These are only available when vector.h is included before this file.
+ */
+
+/**
+ * Calls each for every value of the vector in parallel. The vector must not
+ * change while this runs.
+ * @param vector The vector.
+ * @param tasks The pool.
+ * @param grain The number of values per chunk, as for sb_tasks_parallel_for.
+ * @param each Called with every value and its index.
+ * @param context Passed to each.
+ */
+__songbird_header__
+void sb_vector_parallel_for(sb_vector_t *vector, sb_tasks_t *tasks,
+	unsigned grain, sb_tasks_each_f each, void *context);
+
+/**
+ * Reduces the values of the vector in parallel, see sb_tasks_parallel_reduce.
+ * fold gets runs of consecutive entries instead of indices.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+__songbird_header__
+int sb_vector_parallel_reduce(sb_vector_t *vector, sb_tasks_t *tasks,
+	unsigned grain, void *result, size_t size, sb_tasks_fold_f fold,
+	sb_tasks_combine_f combine, void *context);
+#endif /* __SONGBIRD_VECTOR_H__ */
+
+#ifdef __SONGBIRD_ARRAY_H__
+/*
+ * These are only available when array.h is included before this file.
+ */
+
+/**
+ * Replaces every value of the array with what map returns for it, in
+ * parallel.
+ * @param array The array.
+ * @param tasks The pool.
+ * @param grain The number of values per chunk, as for sb_tasks_parallel_for.
+ * @param map Called with every value and its index.
+ * @param context Passed to map.
+ */
+__songbird_header__
+void sb_array_parallel_map(sb_array_t *array, sb_tasks_t *tasks,
+	unsigned grain, sb_tasks_map_f map, void *context);
+
+/**
+ * Reduces the values of the array in parallel, see sb_tasks_parallel_reduce.
+ * fold gets runs of consecutive entries instead of indices.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+__songbird_header__
+int sb_array_parallel_reduce(sb_array_t *array, sb_tasks_t *tasks,
+	unsigned grain, void *result, size_t size, sb_tasks_fold_f fold,
+	sb_tasks_combine_f combine, void *context);
+#endif /* __SONGBIRD_ARRAY_H__ */
+
+#if defined(__SONGBIRD_VECTOR_H__) || defined(__SONGBIRD_ARRAY_H__)
+struct __sb_tasks_entries {
+	void const **entries;
+	sb_tasks_fold_f fold;
+	void *context;
+};
+
+__songbird_header__
+void __sb_tasks_fold_range(void *context, unsigned begin, unsigned end, void *partial) {
+	struct __sb_tasks_entries *adapter = (struct __sb_tasks_entries *)context;
+	adapter->fold(adapter->context, adapter->entries + begin, end - begin, partial);
+}
+
+__songbird_header__
+int __sb_tasks_fold(void const **entries, unsigned count, sb_tasks_t *tasks,
+		unsigned grain, void *result, size_t size, sb_tasks_fold_f fold,
+		sb_tasks_combine_f combine, void *context) {
+	struct __sb_tasks_entries adapter;
+	adapter.entries = entries;
+	adapter.fold = fold;
+	adapter.context = context;
+	return sb_tasks_parallel_reduce(tasks, count, grain, result, size,
+			__sb_tasks_fold_range, combine, &adapter);
+}
+#endif
+
+#ifdef __SONGBIRD_VECTOR_H__
+struct __sb_tasks_each {
+	void const **entries;
+	sb_tasks_each_f each;
+	void *context;
+};
+
+__songbird_header__
+void __sb_tasks_each_range(void *context, unsigned begin, unsigned end) {
+	struct __sb_tasks_each *adapter = (struct __sb_tasks_each *)context;
+	for(; begin < end; ++begin) {
+		adapter->each(adapter->context, adapter->entries[begin], begin);
+	}
+}
+
+__songbird_header__
+void sb_vector_parallel_for(sb_vector_t *vector, sb_tasks_t *tasks,
+		unsigned grain, sb_tasks_each_f each, void *context) {
+	struct __sb_tasks_each adapter;
+	adapter.entries = vector->entries;
+	adapter.each = each;
+	adapter.context = context;
+	sb_tasks_parallel_for(tasks, vector->size, grain, __sb_tasks_each_range, &adapter);
+}
+
+__songbird_header__
+int sb_vector_parallel_reduce(sb_vector_t *vector, sb_tasks_t *tasks,
+		unsigned grain, void *result, size_t size, sb_tasks_fold_f fold,
+		sb_tasks_combine_f combine, void *context) {
+	return __sb_tasks_fold(vector->entries, vector->size, tasks, grain,
+			result, size, fold, combine, context);
+}
+#endif /* __SONGBIRD_VECTOR_H__ */
+
+#ifdef __SONGBIRD_ARRAY_H__
+struct __sb_tasks_map {
+	void const **entries;
+	sb_tasks_map_f map;
+	void *context;
+};
+
+__songbird_header__
+void __sb_tasks_map_range(void *context, unsigned begin, unsigned end) {
+	struct __sb_tasks_map *adapter = (struct __sb_tasks_map *)context;
+	for(; begin < end; ++begin) {
+		adapter->entries[begin] = adapter->map(adapter->context,
+				adapter->entries[begin], begin);
+	}
+}
+
+__songbird_header__
+void sb_array_parallel_map(sb_array_t *array, sb_tasks_t *tasks,
+		unsigned grain, sb_tasks_map_f map, void *context) {
+	struct __sb_tasks_map adapter;
+	adapter.entries = array->entries;
+	adapter.map = map;
+	adapter.context = context;
+	sb_tasks_parallel_for(tasks, array->size, grain, __sb_tasks_map_range, &adapter);
+}
+
+__songbird_header__
+int sb_array_parallel_reduce(sb_array_t *array, sb_tasks_t *tasks,
+		unsigned grain, void *result, size_t size, sb_tasks_fold_f fold,
+		sb_tasks_combine_f combine, void *context) {
+	return __sb_tasks_fold(array->entries, array->size, tasks, grain,
+			result, size, fold, combine, context);
+}
+#endif /* __SONGBIRD_ARRAY_H__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef __songbird_header__
+
+#endif /* __SONGBIRD_TASKS_H__ */
@@ -0,0 +1,359 @@
+/**
+ * Copyright (c) 2014-2017 Robert Maupin <chasesan@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SONGBIRD_TVECTOR_H__
+#define __SONGBIRD_TVECTOR_H__
+
+#ifndef __SB_NO_ALLOC__
+#include <stdlib.h>
+#define sb_malloc malloc
+#define sb_realloc realloc
+#define sb_free free
+#endif /* __SB_NO_ALLOC__ */
+
+#ifndef __SB_ALLOCATOR__
+#define __SB_ALLOCATOR__
+#include <stddef.h>
+/*
+ * A runtime allocator, handed to a container when it is initialized. A NULL
+ * allocator stands for sb_malloc, sb_realloc and sb_free. The allocator has
+ * to outlive every container using it and release has to accept NULL.
+ * alloc.h provides arena and pool allocators.
+ */
+typedef struct sb_allocator {
+	void *(*alloc)(void *context, size_t size);
+	void *(*resize)(void *context, void *ptr, size_t size);
+	void (*release)(void *context, void *ptr);
+	void *context;
+} sb_allocator_t;
+#define __sb_allocate(a, size) \
+	((a) ? (a)->alloc((a)->context, (size)) : sb_malloc(size))
+#define __sb_reallocate(a, ptr, size) \
+	((a) ? (a)->resize((a)->context, (ptr), (size)) : sb_realloc((ptr), (size)))
+#define __sb_deallocate(a, ptr) \
+	((a) ? (a)->release((a)->context, (ptr)) : sb_free(ptr))
+#endif
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+/* Not sure why you would want to use this in C++, but just in case. */
+extern "C" {
+#define __songbird_tvector__	inline
+/* Works even if __STDC_VERSION__ is not defined. */
+#elif __STDC_VERSION__ <= 199409L
+#define __songbird_tvector__	static __inline__
+#else
+#define __songbird_tvector__	static inline
+#endif
+
+#ifndef __SB_ERROR__
+#define __SB_ERROR__
+enum {
+	SB_ERROR_NONE = 0,
+	SB_ERROR_MEMORY_ALLOCATION = 1,
+	SB_ERROR_OUT_OF_BOUNDS = 2,
+};
+#if __STDC_VERSION__ >= 201112L && !defined __STDC_NO_THREADS__
+__thread int sb_error = SB_ERROR_NONE;
+#else
+int sb_error = SB_ERROR_NONE;
+#endif
+#define sb_error() (sb_error)
+#define sb_error_clear() (sb_error = SB_ERROR_NONE)
+#endif
+
+enum {
+	SB_TVECTOR_DEFAULT_CAPACITY = 16,
+	/* storage below this many bytes doubles, above it grows by half */
+	SB_TVECTOR_DOUBLE_LIMIT = 1 << 20
+};
+
+/**
+ * Works out a capacity of at least needed elements, growing geometrically
+ * from the current one, and reallocates the storage to it. Small storage
+ * doubles, large storage grows by half so that big elements do not waste
+ * as much memory. This function is not designed to be called by the end
+ * user. sb_error is set to SB_ERROR_MEMORY_ALLOCATION if memory allocation
+ * fails.
+ * @param allocator The allocator, or NULL for sb_realloc.
+ * @param entries The current storage.
+ * @param capacity The current capacity, updated on success.
+ * @param needed The number of elements the storage has to fit.
+ * @param elem The size of one element.
+ * @return The new storage, or NULL on failure, in which case the current
+ * 		storage is left as it is.
+ */
+__songbird_tvector__
+void *__sb_tvector_grow(sb_allocator_t const *allocator, void *entries,
+		unsigned *capacity, unsigned needed, size_t elem) {
+	unsigned new_capacity = *capacity ? *capacity : (unsigned)SB_TVECTOR_DEFAULT_CAPACITY;
+	unsigned step;
+	void *new_entries;
+	while(new_capacity < needed) {
+		step = (size_t)new_capacity * elem < SB_TVECTOR_DOUBLE_LIMIT
+				? new_capacity : new_capacity / 2;
+		if(step == 0) {
+			step = 1;
+		}
+		if(new_capacity > (unsigned)-1 - step) {
+			new_capacity = needed;
+			break;
+		}
+		new_capacity += step;
+	}
+	if(new_capacity > (size_t)-1 / elem) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return NULL; /* FAILURE! */
+	}
+	new_entries = __sb_reallocate(allocator, entries, elem * new_capacity);
+	if(new_entries == NULL) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return NULL; /* FAILURE! */
+	}
+	*capacity = new_capacity;
+	return new_entries;
+}
+
+/**
+ * Declares a vector that stores values of type T contiguously, without the
+ * extra allocation and pointer of a sb_vector_t entry. It produces the type
+ * name##_t and the functions below, which behave like their sb_vector_*
+ * counterparts. The same declaration must not be repeated in one
+ * translation unit.
+ *
+ *   void name##_init(name##_t *vector);
+ *   void name##_init_cap(name##_t *vector, unsigned capacity);
+ *   void name##_init_alloc(name##_t *vector, unsigned capacity,
+ *   		sb_allocator_t const *allocator);
+ *   void name##_free(name##_t *vector);
+ *   unsigned name##_size(name##_t *vector);
+ *   void name##_reserve(name##_t *vector, unsigned capacity);
+ *   void name##_add(name##_t *vector, T value);
+ *   T *name##_push(name##_t *vector);
+ *   void name##_insert(name##_t *vector, unsigned index, T value);
+ *   void name##_insert_range(name##_t *vector, unsigned index,
+ *   		T const *values, unsigned count);
+ *   void name##_append_array(name##_t *vector, T const *values,
+ *   		unsigned count);
+ *   T *name##_get(name##_t *vector, unsigned index);
+ *   void name##_set(name##_t *vector, unsigned index, T value);
+ *   void name##_remove(name##_t *vector, unsigned index, T *removed);
+ *   void name##_remove_range(name##_t *vector, unsigned index,
+ *   		unsigned count);
+ *   void name##_iterate(name##_t *vector, void (*iter)(T const *));
+ *
+ * name##_push appends an uninitialized element and returns it, or NULL if
+ * the expansion fails, so it can be filled in place. name##_get returns a
+ * pointer into the storage, or NULL if the index is out of bounds; it stays
+ * valid until the vector next grows. name##_remove copies the removed value
+ * into removed unless it is NULL. sb_error is set the same way as by the
+ * sb_vector_* functions.
+ */
+#define SB_VECTOR_DECLARE(name, T) \
+typedef struct name { \
+	unsigned const size; \
+	unsigned const capacity; \
+	T *entries; \
+	sb_allocator_t const *allocator; \
+} name##_t; \
+\
+__songbird_tvector__ \
+void name##_init_alloc(name##_t *vector, unsigned capacity, \
+		sb_allocator_t const *allocator) { \
+	if(capacity == 0) { \
+		capacity = SB_TVECTOR_DEFAULT_CAPACITY; \
+	} \
+	*(unsigned *)&vector->size = 0; \
+	*(unsigned *)&vector->capacity = capacity; \
+	vector->allocator = allocator; \
+	vector->entries = (T *)__sb_allocate(allocator, sizeof(T) * capacity); \
+	if(vector->entries == NULL) { \
+		*(unsigned *)&vector->capacity = 0; \
+		sb_error = SB_ERROR_MEMORY_ALLOCATION; \
+	} \
+} \
+\
+__songbird_tvector__ \
+void name##_init_cap(name##_t *vector, unsigned capacity) { \
+	name##_init_alloc(vector, capacity, NULL); \
+} \
+\
+__songbird_tvector__ \
+void name##_init(name##_t *vector) { \
+	name##_init_cap(vector, SB_TVECTOR_DEFAULT_CAPACITY); \
+} \
+\
+__songbird_tvector__ \
+void name##_free(name##_t *vector) { \
+	if(!vector) { \
+		return; \
+	} \
+	__sb_deallocate(vector->allocator, vector->entries); \
+	vector->entries = NULL; \
+	*(unsigned *)&vector->size = 0; \
+	*(unsigned *)&vector->capacity = 0; \
+} \
+\
+__songbird_tvector__ \
+unsigned name##_size(name##_t *vector) { \
+	return vector->size; \
+} \
+\
+/* returns 0 if the vector fits needed elements, -1 if it cannot grow */ \
+__songbird_tvector__ \
+int __##name##_fit(name##_t *vector, unsigned needed) { \
+	T *new_entries; \
+	if(needed <= vector->capacity) { \
+		return 0; \
+	} \
+	new_entries = (T *)__sb_tvector_grow(vector->allocator, vector->entries, \
+			(unsigned *)&vector->capacity, needed, sizeof(T)); \
+	if(new_entries == NULL) { \
+		return -1; \
+	} \
+	vector->entries = new_entries; \
+	return 0; \
+} \
+\
+__songbird_tvector__ \
+void name##_reserve(name##_t *vector, unsigned capacity) { \
+	__##name##_fit(vector, capacity); \
+} \
+\
+__songbird_tvector__ \
+T *name##_push(name##_t *vector) { \
+	if(vector->size == vector->capacity \
+			&& __##name##_fit(vector, vector->size + 1)) { \
+		return NULL; \
+	} \
+	return &vector->entries[(*(unsigned *)&vector->size)++]; \
+} \
+\
+__songbird_tvector__ \
+void name##_add(name##_t *vector, T value) { \
+	T *slot = name##_push(vector); \
+	if(slot != NULL) { \
+		*slot = value; \
+	} \
+} \
+\
+__songbird_tvector__ \
+void name##_insert_range(name##_t *vector, unsigned index, \
+		T const *values, unsigned count) { \
+	if(index > vector->size) { \
+		sb_error = SB_ERROR_OUT_OF_BOUNDS; \
+		return; \
+	} \
+	if(count == 0) { \
+		return; \
+	} \
+	if(count > (unsigned)-1 - vector->size) { \
+		sb_error = SB_ERROR_MEMORY_ALLOCATION; \
+		return; \
+	} \
+	if(__##name##_fit(vector, vector->size + count)) { \
+		return; \
+	} \
+	/* move everything after added index up count */ \
+	memmove(vector->entries + index + count, vector->entries + index, \
+			sizeof(T) * (vector->size - index)); \
+	memcpy(vector->entries + index, values, sizeof(T) * count); \
+	*(unsigned *)&vector->size += count; \
+} \
+\
+__songbird_tvector__ \
+void name##_insert(name##_t *vector, unsigned index, T value) { \
+	name##_insert_range(vector, index, &value, 1); \
+} \
+\
+__songbird_tvector__ \
+void name##_append_array(name##_t *vector, T const *values, \
+		unsigned count) { \
+	name##_insert_range(vector, vector->size, values, count); \
+} \
+\
+__songbird_tvector__ \
+T *name##_get(name##_t *vector, unsigned index) { \
+	if(index >= vector->size) { \
+		sb_error = SB_ERROR_OUT_OF_BOUNDS; \
+		return NULL; \
+	} \
+	return &vector->entries[index]; \
+} \
+\
+__songbird_tvector__ \
+void name##_set(name##_t *vector, unsigned index, T value) { \
+	if(index >= vector->size) { \
+		sb_error = SB_ERROR_OUT_OF_BOUNDS; \
+		return; \
+	} \
+	vector->entries[index] = value; \
+} \
+\
+__songbird_tvector__ \
+void name##_remove_range(name##_t *vector, unsigned index, \
+		unsigned count) { \
+	if(index > vector->size || count > vector->size - index) { \
+		sb_error = SB_ERROR_OUT_OF_BOUNDS; \
+		return; \
+	} \
+	/* move everything after the removed range down count */ \
+	memmove(vector->entries + index, vector->entries + index + count, \
+			sizeof(T) * (vector->size - index - count)); \
+	*(unsigned *)&vector->size -= count; \
+} \
+\
+__songbird_tvector__ \
+void name##_remove(name##_t *vector, unsigned index, T *removed) { \
+	if(index >= vector->size) { \
+		sb_error = SB_ERROR_OUT_OF_BOUNDS; \
+		return; \
+	} \
+	if(removed != NULL) { \
+		*removed = vector->entries[index]; \
+	} \
+	name##_remove_range(vector, index, 1); \
+} \
+\
+__songbird_tvector__ \
+void name##_iterate(name##_t *vector, void (*iter)(T const *)) { \
+	unsigned i = 0; \
+	if(iter == NULL) { \
+		return; \
+	} \
+	for(; i < vector->size; ++i) { \
+		iter(&vector->entries[i]); \
+	} \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * __songbird_tvector__ stays defined, the functions SB_VECTOR_DECLARE
+ * produces are expanded after this point.
+ */
+
+#endif /* __SONGBIRD_TVECTOR_H__ */
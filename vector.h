@@ -23,14 +23,38 @@
 #ifndef __SONGBIRD_VECTOR_H__
 #define __SONGBIRD_VECTOR_H__
 
-#ifndef __SB_ALLOC__
-#define __SB_ALLOC__
+#ifndef __SB_NO_ALLOC__
 #include <stdlib.h>
 #define sb_malloc malloc
 #define sb_realloc realloc
 #define sb_free free
 #endif /* __SB_NO_ALLOC__ */
 
+#ifndef __SB_ALLOCATOR__
+#define __SB_ALLOCATOR__
+#include <stddef.h>
+/*
+ * A runtime allocator, handed to a container when it is initialized. A NULL
+ * allocator stands for sb_malloc, sb_realloc and sb_free. The allocator has
+ * to outlive every container using it and release has to accept NULL.
+ * alloc.h provides arena and pool allocators.
+ */
+typedef struct sb_allocator {
+	void *(*alloc)(void *context, size_t size);
+	void *(*resize)(void *context, void *ptr, size_t size);
+	void (*release)(void *context, void *ptr);
+	void *context;
+} sb_allocator_t;
+#define __sb_allocate(a, size) \
+	((a) ? (a)->alloc((a)->context, (size)) : sb_malloc(size))
+#define __sb_reallocate(a, ptr, size) \
+	((a) ? (a)->resize((a)->context, (ptr), (size)) : sb_realloc((ptr), (size)))
+#define __sb_deallocate(a, ptr) \
+	((a) ? (a)->release((a)->context, (ptr)) : sb_free(ptr))
+#endif
+
+#include <string.h>
+
 #ifdef __cplusplus
 /* Not sure why you would want to use this in C++, but just in case. */
 extern "C" {
@@ -63,6 +87,14 @@ int sb_error = SB_ERROR_NONE;
 typedef void (*sb_iter_f)(void const *);
 #endif
 
+#ifndef __songbird_each_func__
+#define __songbird_each_func__
+/** gets the context, a value and its index, non-zero stops the iteration */
+typedef int (*sb_each_f)(void *context, void const *value, unsigned index);
+/** gets count consecutive entries, the first at index, non-zero stops */
+typedef int (*sb_span_f)(void *context, void const **entries, unsigned count, unsigned index);
+#endif
+
 enum {
 	SB_VECTOR_DEFAULT_CAPACITY = 16,
 };
@@ -77,6 +109,7 @@ typedef struct sb_vector {
 	unsigned const size;
 	unsigned const capacity;
 	void const **entries;
+	sb_allocator_t const *allocator;
 } sb_vector_t;
 
 /**
@@ -97,6 +130,19 @@ void sb_vector_init(sb_vector_t *vector);
 __songbird_header__
 void sb_vector_init_cap(sb_vector_t *vector, unsigned capacity);
 
+/**
+ * Initializes the specified vector with the given initial capacity, taking
+ * its memory from the given allocator. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation fails.
+ * @param vector The vector to initialize.
+ * @param capacity The initial capacity of the vector, if 0 it defaults to 16
+ * 		(the SB_VECTOR_DEFAULT_CAPACITY).
+ * @param allocator The allocator, or NULL for sb_malloc.
+ */
+__songbird_header__
+void sb_vector_init_alloc(sb_vector_t *vector, unsigned capacity,
+	sb_allocator_t const *allocator);
+
 /**
  * Frees all allocated memory for the given vector.
  * @param vector The vector to free.
@@ -134,6 +180,34 @@ void sb_vector_add(sb_vector_t *vector, void const *value);
 __songbird_header__
 void sb_vector_insert(sb_vector_t *vector, unsigned index, void const *value);
 
+/**
+ * Inserts count values into the vector at the given index, expanding the
+ * vector at most once. sb_error is set to SB_ERROR_OUT_OF_BOUNDS if index is
+ * out of bounds for the vector. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if the memory allocation during expansion
+ * fails, in which case the vector is left unchanged.
+ * @param vector The vector.
+ * @param index The index to insert at.
+ * @param values The values to insert.
+ * @param count The number of values to insert.
+ */
+__songbird_header__
+void sb_vector_insert_range(sb_vector_t *vector, unsigned index,
+	void const **values, unsigned count);
+
+/**
+ * Adds count values to the end of the vector, expanding the vector at most
+ * once. sb_error is set to SB_ERROR_MEMORY_ALLOCATION if the memory
+ * allocation during expansion fails, in which case the vector is left
+ * unchanged.
+ * @param vector The vector.
+ * @param values The values to add.
+ * @param count The number of values to add.
+ */
+__songbird_header__
+void sb_vector_append_array(sb_vector_t *vector,
+	void const **values, unsigned count);
+
 /**
  * Gets a value from the given index. sb_error is set to
  * SB_ERROR_OUT_OF_BOUNDS if index is out of bounds for the vector.
@@ -169,6 +243,18 @@ void const *sb_vector_set(sb_vector_t *vector,
 __songbird_header__
 void const *sb_vector_remove(sb_vector_t *vector, unsigned index);
 
+/**
+ * Removes count values starting at the given index. sb_error is set to
+ * SB_ERROR_OUT_OF_BOUNDS if the range does not fit in the vector, in which
+ * case nothing is removed.
+ * @param vector The vector.
+ * @param index The index of the first value to remove.
+ * @param count The number of values to remove.
+ */
+__songbird_header__
+void sb_vector_remove_range(sb_vector_t *vector, unsigned index,
+	unsigned count);
+
 /**
  * Iteraters through the given vector calling the specified iteration
  * function. This function does nothing if the specified iteration function
@@ -180,6 +266,30 @@ void const *sb_vector_remove(sb_vector_t *vector, unsigned index);
 __songbird_header__
 void sb_vector_iterate(sb_vector_t *vector, sb_iter_f iter);
 
+/**
+ * Iterates through the given vector calling the specified function with the
+ * context, every value and its index, until it returns non-zero.
+ * @param vector The vector.
+ * @param each The function to call, it must not be NULL.
+ * @param context Passed to each.
+ * @return The index at which each returned non-zero, or the size of the
+ * 		vector if it never did.
+ */
+__songbird_header__
+unsigned sb_vector_each(sb_vector_t *vector, sb_each_f each, void *context);
+
+/**
+ * Hands the entries of the given vector to the specified function as
+ * contiguous spans, so the function can loop over them itself. All entries
+ * are one span, an empty vector has none.
+ * @param vector The vector.
+ * @param span The function to call, it must not be NULL.
+ * @param context Passed to span.
+ * @return What span returned if it was non-zero, otherwise 0.
+ */
+__songbird_header__
+int sb_vector_each_span(sb_vector_t *vector, sb_span_f span, void *context);
+
 /* function definitions */
 
 __songbird_header__
@@ -189,12 +299,20 @@ void sb_vector_init(sb_vector_t *vector) {
 
 __songbird_header__
 void sb_vector_init_cap(sb_vector_t *vector, unsigned capacity) {
+	sb_vector_init_alloc(vector, capacity, NULL);
+}
+
+__songbird_header__
+void sb_vector_init_alloc(sb_vector_t *vector, unsigned capacity,
+		sb_allocator_t const *allocator) {
 	if(capacity == 0) {
 		capacity = SB_VECTOR_DEFAULT_CAPACITY;
 	}
 	*(unsigned *)&vector->size = 0;
 	*(unsigned *)&vector->capacity = capacity;
-	vector->entries = (void const **)sb_malloc(sizeof(void *) * capacity);
+	vector->allocator = allocator;
+	vector->entries = (void const **)__sb_allocate(allocator,
+			sizeof(void *) * capacity);
 	if(vector->entries == NULL) {
 		sb_error = SB_ERROR_MEMORY_ALLOCATION;
 	}
@@ -206,7 +324,7 @@ void sb_vector_free(sb_vector_t *vector) {
 		return;
 	}
 	if(vector->capacity > 0) {
-		sb_free(vector->entries);
+		__sb_deallocate(vector->allocator, (void *)vector->entries);
 	}
 }
 
@@ -226,7 +344,8 @@ void __sb_vector_resize(sb_vector_t *vector) {
 	/* double size */
 	unsigned new_capacity = vector->capacity * 2;
 	void const **new_entries = (const void **)
-			sb_realloc(vector->entries, sizeof(void *) * new_capacity);
+			__sb_reallocate(vector->allocator, (void *)vector->entries,
+			sizeof(void *) * new_capacity);
 	if(new_entries == NULL) {
 		sb_error = SB_ERROR_MEMORY_ALLOCATION;
 		return; /* FAILURE! */
@@ -235,18 +354,51 @@ void __sb_vector_resize(sb_vector_t *vector) {
 	*(unsigned *)&vector->capacity = new_capacity;
 }
 
+/**
+ * Expands the vector so that it can hold more than size entries, doubling
+ * its capacity as many times as needed but reallocating only once. This
+ * function is not designed to be called by the end user. sb_error is set to
+ * SB_ERROR_MEMORY_ALLOCATION if memory allocation fails during resize.
+ * @param vector The vector.
+ * @param size The number of entries the vector has to fit.
+ * @return 0 on success, -1 on failure.
+ */
+__songbird_header__
+int __sb_vector_reserve(sb_vector_t *vector, unsigned size) {
+	unsigned new_capacity = vector->capacity;
+	void const **new_entries;
+	if(size < new_capacity) {
+		return 0;
+	}
+	while(new_capacity <= size) {
+		if(new_capacity > (unsigned)-1 / 2) {
+			sb_error = SB_ERROR_MEMORY_ALLOCATION;
+			return -1; /* FAILURE! */
+		}
+		new_capacity *= 2;
+	}
+	new_entries = (const void **)
+			__sb_reallocate(vector->allocator, (void *)vector->entries,
+			sizeof(void *) * new_capacity);
+	if(new_entries == NULL) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return -1; /* FAILURE! */
+	}
+	vector->entries = new_entries;
+	*(unsigned *)&vector->capacity = new_capacity;
+	return 0;
+}
+
 __songbird_header__
 void sb_vector_insert(sb_vector_t *vector, unsigned index,
 		const void *value) {
-	unsigned i;
 	if(index > vector->size) {
 		sb_error = SB_ERROR_OUT_OF_BOUNDS;
 		return;
 	}
 	/* move everything after added index up one */
-	for(i = vector->size; i > index; --i) {
-		vector->entries[i] = vector->entries[i - 1];
-	}
+	memmove(vector->entries + index + 1, vector->entries + index,
+			sizeof(void *) * (vector->size - index));
 	vector->entries[index] = value;
 	if(++ * (unsigned *)&vector->size == vector->capacity) {
 		__sb_vector_resize(vector);
@@ -255,7 +407,38 @@ void sb_vector_insert(sb_vector_t *vector, unsigned index,
 
 __songbird_header__
 void sb_vector_add(sb_vector_t *vector, const void *value) {
-	sb_vector_insert(vector, vector->size, value);
+	vector->entries[vector->size] = value;
+	if(++ * (unsigned *)&vector->size == vector->capacity) {
+		__sb_vector_resize(vector);
+	}
+}
+
+__songbird_header__
+void sb_vector_insert_range(sb_vector_t *vector, unsigned index,
+		void const **values, unsigned count) {
+	if(index > vector->size) {
+		sb_error = SB_ERROR_OUT_OF_BOUNDS;
+		return;
+	}
+	if(count == 0) {
+		return;
+	}
+	if(count > (unsigned)-1 - vector->size
+			|| __sb_vector_reserve(vector, vector->size + count)) {
+		sb_error = SB_ERROR_MEMORY_ALLOCATION;
+		return;
+	}
+	/* move everything after added index up count */
+	memmove(vector->entries + index + count, vector->entries + index,
+			sizeof(void *) * (vector->size - index));
+	memcpy(vector->entries + index, values, sizeof(void *) * count);
+	*(unsigned *)&vector->size += count;
+}
+
+__songbird_header__
+void sb_vector_append_array(sb_vector_t *vector,
+		void const **values, unsigned count) {
+	sb_vector_insert_range(vector, vector->size, values, count);
 }
 
 __songbird_header__
@@ -289,12 +472,25 @@ void const *sb_vector_remove(sb_vector_t *vector, unsigned index) {
 	}
 	retval = vector->entries[index];
 	/* move everything after removed index down one */
-	for(-- * (unsigned *)&vector->size; index <= vector->size; ++index) {
-		vector->entries[index] = vector->entries[index + 1];
-	}
+	-- * (unsigned *)&vector->size;
+	memmove(vector->entries + index, vector->entries + index + 1,
+			sizeof(void *) * (vector->size - index));
 	return retval;
 }
 
+__songbird_header__
+void sb_vector_remove_range(sb_vector_t *vector, unsigned index,
+		unsigned count) {
+	if(index > vector->size || count > vector->size - index) {
+		sb_error = SB_ERROR_OUT_OF_BOUNDS;
+		return;
+	}
+	/* move everything after the removed range down count */
+	memmove(vector->entries + index, vector->entries + index + count,
+			sizeof(void *) * (vector->size - index - count));
+	*(unsigned *)&vector->size -= count;
+}
+
 __songbird_header__
 void sb_vector_iterate(sb_vector_t *vector, sb_iter_f iterfun) {
 	unsigned i = 0;
@@ -306,6 +502,25 @@ void sb_vector_iterate(sb_vector_t *vector, sb_iter_f iterfun) {
 	}
 }
 
+__songbird_header__
+unsigned sb_vector_each(sb_vector_t *vector, sb_each_f each, void *context) {
+	unsigned i = 0;
+	for(; i < vector->size; ++i) {
+		if(each(context, vector->entries[i], i)) {
+			break;
+		}
+	}
+	return i;
+}
+
+__songbird_header__
+int sb_vector_each_span(sb_vector_t *vector, sb_span_f span, void *context) {
+	if(vector->size == 0) {
+		return 0;
+	}
+	return span(context, vector->entries, vector->size, 0);
+}
+
 #ifdef __cplusplus
 }
 #endif